@@ -67,6 +67,15 @@
 // 将此设置为 1 要在所有时刻都完整验证自动释放池的 header。（也就是 magic_t 的 check() 和 fastcheck()，完整验证数组的 4 个元素全部相等，还是只要验证第一个元素相等，当设置为 1 在任何地方使用 check() 代替 fastcheck()，可看出在 Debug 状态下是进行的完整验证，其它情况都是快速验证）
 #define CHECK_AUTORELEASEPOOL (DEBUG)
 
+// Define SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS to combine consecutive 
+// autoreleases of the same object into one pool entry with a count.
+// The pointer keeps the low 48 bits of each entry and the count the rest.
+#if __LP64__
+#   define SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS 1
+#else
+#   define SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS 0
+#endif
+
 #ifdef __cplusplus
 #include <string.h>
 #include <assert.h>
@@ -157,6 +166,16 @@ struct magic_t {
 class AutoreleasePoolPage;
 struct AutoreleasePoolPageData
 {
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+    // count is the number of autoreleases beyond the first.
+    struct AutoreleasePoolEntry {
+        uintptr_t ptr: 48;
+        uintptr_t count: 16;
+
+        static const uintptr_t maxCount = 65535; // 2^16 - 1
+    };
+#endif
+
     // struct magic_t 作为 AutoreleasePoolPage 的 header 来验证 AutoreleasePoolPage
     // 0xA1A1A1A1AUTORELEASE!
 	magic_t const magic;
@@ -51,6 +51,11 @@ OBJC_EXTERN const uint32_t objc_debug_autoreleasepoolpage_parent_offset = __buil
 OBJC_EXTERN const uint32_t objc_debug_autoreleasepoolpage_child_offset  = __builtin_offsetof(AutoreleasePoolPageData, child);
 OBJC_EXTERN const uint32_t objc_debug_autoreleasepoolpage_depth_offset  = __builtin_offsetof(AutoreleasePoolPageData, depth);
 OBJC_EXTERN const uint32_t objc_debug_autoreleasepoolpage_hiwat_offset  = __builtin_offsetof(AutoreleasePoolPageData, hiwat);
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+OBJC_EXTERN const uintptr_t objc_debug_autoreleasepoolpage_ptr_mask = (AutoreleasePoolPageData::AutoreleasePoolEntry){ .ptr = ~(uintptr_t)0 }.ptr;
+#else
+OBJC_EXTERN const uintptr_t objc_debug_autoreleasepoolpage_ptr_mask = ~(uintptr_t)0;
+#endif
 #if __OBJC2__
 OBJC_EXTERN const uint32_t objc_class_abi_version = OBJC_CLASS_ABI_VERSION_MAX;
 #endif
@@ -201,11 +206,13 @@ void SideTable::unlockTwo<DontHaveOld, DoHaveNew>
 //SideTables 是一个类型是 StripedMap<SideTable> 的静态全局哈希表。在iPhone下它是固定长度为 8 的哈希数组，在 mac 下是固定长度为 64 的哈希数组，自带一个简单的哈希函数，根据 void * 入参计算哈希值，然后根据哈希值取得哈希数组中对应的 T。
 //SideTables 中则是取得 SideTable。
 /// ExplicitInit 内部 _storage 数组长度是: alignas(StripedMap<SideTable>) sizeof(StripedMap<SideTable>)
-static objc::ExplicitInit<StripedMap<SideTable>> SideTablesMap;
+// The stripe count is picked from the CPU count when arr_init() 
+// constructs the map.
+static objc::ExplicitInit<ScalableStripedMap<SideTable>> SideTablesMap;
 
 
 
-static StripedMap<SideTable>& SideTables() {
+static ScalableStripedMap<SideTable>& SideTables() {
     return SideTablesMap.get();
 }
 
@@ -252,6 +259,12 @@ void SideTableLocksSucceedLocks(StripedMap<spinlock_t>& oldlocks) {
     }
 }
 
+void SideTableLocksProfile() {
+    for (unsigned int i = 0; i < SideTables().count(); i++) {
+        lockprofile_register(&SideTables().at(i).slock, "SideTable", (int)i);
+    }
+}
+
 //
 // The -fobjc-arc flag causes the compiler to issue calls to objc_{retain/release/autorelease/retain_block}
 //
@@ -577,6 +590,220 @@ objc_destroyWeak(id *location)
 }
 
 
+#if SUPPORT_NONPOINTER_ISA
+
+/***********************************************************************
+* Lock-free weak loads.
+* The SideTable lock in objc_loadWeakRetained() only keeps the referent 
+* from being freed between reading the weak variable and retaining it. 
+* Instead, a reader publishes an odd sequence number in its own 
+* weak_reader_t for the duration of the load. A weakly referenced 
+* object that is deallocating clears its weak variables and then waits 
+* for every reader that was loading at that moment to finish 
+* (weak_wait_for_readers()). A reader that loaded the object before it 
+* was cleared sees the deallocating bit in its try-retain and gets nil.
+*
+* Only objects with nonpointer isa and default RR take this path. 
+* sidetable_tryRetain() and -retainWeakReference need the lock.
+**********************************************************************/
+
+struct weak_reader_t {
+    explicit_atomic<uintptr_t> seq;   // odd while loading
+    explicit_atomic<bool> inUse;
+    weak_reader_t *next;
+};
+
+static explicit_atomic<weak_reader_t *> weak_readers{nil};
+static tls_key_t weak_reader_key;
+static bool weak_readers_ready;
+
+static void weak_reader_thread_exit(void *arg)
+{
+    auto reader = (weak_reader_t *)arg;
+    reader->inUse.store(false, std::memory_order_release);
+}
+
+static weak_reader_t *weak_reader_register(void)
+{
+    weak_reader_t *reader;
+
+    // Reuse a reader abandoned by an exited thread.
+    for (reader = weak_readers.load(std::memory_order_acquire);
+         reader;
+         reader = reader->next)
+    {
+        bool expected = false;
+        if (!reader->inUse.load(std::memory_order_relaxed)  &&
+            reader->inUse.compare_exchange_strong(expected, true,
+                                                  std::memory_order_acquire))
+        {
+            tls_set(weak_reader_key, reader);
+            return reader;
+        }
+    }
+
+    reader = (weak_reader_t *)calloc(1, sizeof(weak_reader_t));
+    reader->inUse.store(true, std::memory_order_relaxed);
+    auto head = weak_readers.load(std::memory_order_relaxed);
+    do {
+        reader->next = head;
+    } while (!weak_readers.compare_exchange_weak
+             (head, reader, std::memory_order_release,
+              std::memory_order_relaxed));
+
+    tls_set(weak_reader_key, reader);
+    return reader;
+}
+
+// Wait for every load that might have read a weak variable 
+// before the caller cleared it.
+static void weak_wait_for_readers(void)
+{
+    if (!weak_readers_ready) return;
+
+    // Order the caller's clearing of the weak variables before the scan.
+    // Pairs with the fence in objc_loadWeakRetained().
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    for (auto reader = weak_readers.load(std::memory_order_acquire);
+         reader;
+         reader = reader->next)
+    {
+        uintptr_t seq = reader->seq.load(std::memory_order_acquire);
+        if (!(seq & 1)) continue;
+        while (reader->seq.load(std::memory_order_acquire) == seq) {
+            // The reader is between two instructions of a short load.
+            // If it was preempted, give it the CPU.
+            sched_yield();
+        }
+    }
+}
+
+// Returns the retained referent, or nil if it is deallocating. 
+// Sets *handled to false if the object needs the locked path.
+static ALWAYS_INLINE id
+weak_loadRetained_lockFree(id *location, bool *handled)
+{
+    auto reader = (weak_reader_t *)tls_get(weak_reader_key);
+    if (slowpath(!reader)) reader = weak_reader_register();
+
+    uintptr_t seq = reader->seq.load(std::memory_order_relaxed);
+    reader->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    id result = *location;
+    if (result  &&  !result->isTaggedPointer()) {
+        if (fastpath(result->hasNonpointerIsa()  &&  
+                     !result->ISA()->hasCustomRR())) 
+        {
+            if (!result->rootTryRetain()) result = nil;
+        } else {
+            *handled = false;
+        }
+    }
+
+    reader->seq.store(seq + 2, std::memory_order_release);
+    return result;
+}
+
+
+/***********************************************************************
+* Lock-free atomic property loads.
+* objc_getProperty() reads atomic object properties as a weak reader 
+* instead of taking the PropertyLocks stripe. The hazard is the same: 
+* a setter may release the value between the read and the retain. 
+* Setters therefore pass the value they replace to property_retire() 
+* before releasing it, which marks it weakly referenced so its 
+* deallocation waits for readers. Values with raw isa cannot be marked 
+* without the SideTable lock, so property_retire() waits for readers 
+* itself.
+*
+* Marking forces the value's deallocation through 
+* clearDeallocating_slow(), and waiting scans every reader in the 
+* process, so setters only pay either cost for slots that have been 
+* read lock-free. A reader sets its slot's PropertyReaders flag before 
+* loading the slot; a setter that finds the flag clear after storing 
+* the new value knows no reader can have loaded the old one. The flags 
+* are striped like PropertyLocks and never cleared: a slot that is 
+* read lock-free once keeps paying, other slots never do.
+**********************************************************************/
+
+struct PropertyReaderFlag {
+    explicit_atomic<bool> used{false};
+};
+static StripedMap<PropertyReaderFlag> PropertyReaders;
+
+// Returns the retained value of *slot. 
+// Sets *handled to false if the value needs the locked path.
+id property_loadRetained_lockFree(id *slot, bool *handled)
+{
+    // Without nonpointer isa every value would need the locked path.
+    if (slowpath(!weak_readers_ready  ||  DisableNonpointerIsa)) {
+        *handled = false;
+        return nil;
+    }
+
+    auto reader = (weak_reader_t *)tls_get(weak_reader_key);
+    if (slowpath(!reader)) reader = weak_reader_register();
+
+    uintptr_t seq = reader->seq.load(std::memory_order_relaxed);
+    reader->seq.store(seq + 1, std::memory_order_relaxed);
+    auto& flag = PropertyReaders[slot].used;
+    if (slowpath(!flag.load(std::memory_order_relaxed))) {
+        flag.store(true, std::memory_order_relaxed);
+    }
+    // Orders the flag before the load of the slot. 
+    // Pairs with the fence in property_retire().
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    id result;
+    while (true) {
+        result = *(id volatile *)slot;
+        if (!result  ||  result->isTaggedPointer()) break;
+        if (slowpath(!result->hasNonpointerIsa()  ||  
+                     result->ISA()->hasCustomRR())) 
+        {
+            *handled = false;
+            result = nil;
+            break;
+        }
+        if (fastpath(result->rootTryRetain())) break;
+
+        // A racing setter replaced and released the value. 
+        // Read the new one, unless nobody replaced it.
+        if (*(id volatile *)slot == result) {
+            *handled = false;
+            result = nil;
+            break;
+        }
+    }
+
+    reader->seq.store(seq + 2, std::memory_order_release);
+    return result;
+}
+
+// value was just replaced in *slot.
+void property_retire(id *slot, id value)
+{
+    if (!value  ||  value->isTaggedPointer()) return;
+
+    // Order the caller's store to the slot before reading the flag.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (fastpath(!PropertyReaders[slot].used.load(std::memory_order_relaxed))) {
+        return;
+    }
+
+    if (fastpath(value->hasNonpointerIsa())) {
+        value->setWeaklyReferenced_nolock();
+    } else {
+        weak_wait_for_readers();
+    }
+}
+
+// SUPPORT_NONPOINTER_ISA
+#endif
+
+
 /*
   Once upon a time we eagerly cleared *location if we saw the object 
   was deallocating. This confuses code like NSPointerFunctions which 
@@ -599,6 +826,14 @@ objc_loadWeakRetained(id *location)
     Class cls;
 
     SideTable *table;
+
+#if SUPPORT_NONPOINTER_ISA
+    if (fastpath(weak_readers_ready)) {
+        bool handled = true;
+        result = weak_loadRetained_lockFree(location, &handled);
+        if (fastpath(handled)) return result;
+    }
+#endif
     
  retry:
     // fixme std::atomic this load
@@ -707,6 +942,26 @@ objc_loadWeak(id *location)
 }
 
 
+/** 
+ * Reports the size and probe lengths of the weak reference tables.
+ * Each side table is locked in turn, so the totals are not a snapshot.
+ */
+void
+objc_weak_getStatistics(objc_weak_table_statistics *stats)
+{
+    bzero(stats, sizeof(*stats));
+
+    auto& tables = SideTables();
+    for (unsigned int i = 0; i < tables.count(); i++) {
+        SideTable& table = tables.at(i);
+        table.lock();
+        weak_table_statistics_no_lock(&table.weak_table, stats);
+        table.unlock();
+        stats->tables++;
+    }
+}
+
+
 /** 
  * This function copies a weak pointer from one location to another,
  * when the destination doesn't already contain a weak pointer. It
@@ -784,12 +1039,17 @@ class AutoreleasePoolPage : private AutoreleasePoolPageData
 // 表示 AutoreleasePoolPage 的容量。已知在 NSObject-internal.h 中 PROTECT_AUTORELEASEPOOL 值为 0，那么 SIZE 的值是 PAGE_MIN_SIZE。（在 vm_param.h 中 PAGE_MAX_SIZE 和 PAGE_MIN_SIZE 都是 4096...）
 //保存的 autorelease 对象的指针，每个指针占 8 个字节）。
 public:
-	static size_t const SIZE =
+	static size_t const DEFAULT_SIZE =
 #if PROTECT_AUTORELEASEPOOL
 		PAGE_MAX_SIZE;  // must be multiple of vm page size
 #else
 		PAGE_MIN_SIZE;  // size and alignment, power of 2
 #endif
+    static size_t const MAX_SIZE = 1024*1024;
+
+    // Size and alignment of every page, a power of 2.
+    // Set once by init() from OBJC_POOL_PAGE_SIZE.
+    static size_t SIZE;
     
 private:
     // 通过此 key 从当前线程的存储中取出 hotPage
@@ -803,7 +1063,11 @@ private:
 	static uint8_t const SCRIBBLE = 0xA3;  // 0xA3A3A3A3 after releasing
     
     /// 可保存的 id 的数量 4096 / 8 = 512 (实际可用容量是 4096 减去成员变量占用的 56 字节 )
-	static size_t const COUNT = SIZE / sizeof(id);
+	static size_t COUNT() { return SIZE / sizeof(id); }
+
+    // Empty pages are kept as children of the hot page, for
+    // autoreleaseFullPage() to reuse, up to this many bytes per thread.
+    static size_t const CACHE_BYTES = 64*1024;
 
     // EMPTY_POOL_PLACEHOLDER is stored in TLS when exactly one pool is 
     // pushed and it has never contained any objects. This saves memory 
@@ -996,11 +1260,34 @@ private:
     {
         ASSERT(!full()); // 如果自动释放池已经满了，则执行断言
         unprotect(); // 可读可写
+        id *ret;
+
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+        if (!DisableAutoreleaseCoalescing  &&  !empty()  &&  
+            obj != POOL_BOUNDARY) 
+        {
+            // Same object as the top entry: count it there instead.
+            AutoreleasePoolEntry *topEntry = (AutoreleasePoolEntry *)next - 1;
+            if (topEntry->ptr == (uintptr_t)obj  &&  
+                topEntry->count < AutoreleasePoolEntry::maxCount) 
+            {
+                topEntry->count++;
+                ret = (id *)topEntry;
+                goto done;
+            }
+        }
+#endif
+
         //// 记录当前 next 的指向，作为函数的返回值。比 `return next-1` 快
-        id *ret = next;  // faster than `return next-1` because of aliasing
+        ret = next;  // faster than `return next-1` because of aliasing
         // next 是一个 objc_object **，先使用解引用操作符 * 取出 objc_object * ，
         // 然后把 obj 赋值给它，然后 next 会做一次自增操作前进 8 个字节，指向下一个位置。
         *next++ = obj;
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+        // Make sure obj fits in the bits available for it.
+        ASSERT(((AutoreleasePoolEntry *)ret)->ptr == (uintptr_t)obj);
+     done:
+#endif
         protect(); // 只可读
         return ret; // ret 目前正是指向 obj 的位置。（obj 是 objc_object 指针，不是 objc_object）
     }
@@ -1041,7 +1328,14 @@ private:
             }
 
             page->unprotect();// 可读可写
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+            AutoreleasePoolEntry *entry = (AutoreleasePoolEntry *)--page->next;
+            // Read both fields before the entry is scribbled.
+            id obj = (id)entry->ptr;
+            uintptr_t count = entry->count;
+#else
             id obj = *--page->next;// next 后移一步，并用解引用符取出 objc_object * 赋值给 obj
+#endif
             // 把 page->next 开始的 sizeof(*page->next) 个字节置为 SCRIBBLE
             memset((void*)page->next, SCRIBBLE, sizeof(*page->next));
             // 只可读
@@ -1049,7 +1343,14 @@ private:
             
             // 如果 obj 不为 nil，则执行 objc_release 操作
             if (obj != POOL_BOUNDARY) {
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+                // One release for the entry and one for each repeat.
+                for (uintptr_t i = 0; i <= count; i++) {
+                    objc_release(obj);
+                }
+#else
                 objc_release(obj);
+#endif
             }
         }
         // 这里还是把 this 作为 hotPage，
@@ -1378,7 +1679,12 @@ public:
         // 1. if (obj != POOL_BOUNDARY  &&  DebugMissingPools) 时 return nil
         // 2. if (obj == POOL_BOUNDARY  &&  !DebugPoolAllocation) 时 return EMPTY_POOL_PLACEHOLDER
         // 3. *dest == obj 正常添加
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+        ASSERT(!dest  ||  dest == EMPTY_POOL_PLACEHOLDER  ||  
+               (id)((AutoreleasePoolEntry *)dest)->ptr == obj);
+#else
         ASSERT(!dest  ||  dest == EMPTY_POOL_PLACEHOLDER  ||  *dest == obj);
+#endif
         return obj;
     }
 
@@ -1444,6 +1750,7 @@ public:
         // 如果允许 debug 并且打开了 OBJC_PRINT_POOL_HIGHWATER，则打印自动释放池的 hiwat（high-water “最高水位”）
 
         if (allowDebug && PrintPoolHiwat) printHiwat();
+        else updateHiwat();
 
         // 把 stop 后面添加进自动释放池的对象全部执行一次 objc_release 操作
         page->releaseUntil(stop);
@@ -1480,16 +1787,17 @@ public:
             // hysteresis: keep one empty child if page is more than half full
             // 如果 page 存储的自动释放对象超过了一半，则保留一个 empty child
 
-            if (page->lessThanHalfFull()) {
-                // 如果 page 内部保存的自动释放对象的数量少于一半
-                // 把 page 以及 page 之后增加的 page 都执行 delete
-                page->child->kill();
-            }
-            else if (page->child->child) {
-                // 如果 page 的 child 的 child 存在
-                // 则把 page->child->child 以及它之后增加的 page 全部执行 delete
-                page->child->child->kill();
+            // The empty children beyond that are the thread's page cache.
+            // Keep as many as fit in CACHE_BYTES and free the rest.
+            size_t keep = std::max(CACHE_BYTES / SIZE, (size_t)1);
+            if (page->lessThanHalfFull()) keep--;
+
+            AutoreleasePoolPage *last = page;
+            while (keep > 0  &&  last->child) {
+                last = last->child;
+                keep--;
             }
+            if (last->child) last->child->kill();
         }
     }
 
@@ -1554,6 +1862,17 @@ public:
 
     static void init()
     {
+        if (PoolPageSize) {
+            size_t size = DEFAULT_SIZE;
+            while (size < (size_t)PoolPageSize  &&  size < MAX_SIZE) size *= 2;
+            if (size != (size_t)PoolPageSize) {
+                _objc_inform("OBJC_POOL_PAGE_SIZE=%d is not a power of 2 "
+                             "from %zu to %zu; using %zu", PoolPageSize, 
+                             DEFAULT_SIZE, MAX_SIZE, size);
+            }
+            SIZE = size;
+        }
+
         // key tls_dealloc 释放对象删除 page
         int r __unused = pthread_key_init_np(AutoreleasePoolPage::key, 
                                              AutoreleasePoolPage::tls_dealloc);
@@ -1575,8 +1894,21 @@ public:
             if (*p == POOL_BOUNDARY) {
                 _objc_inform("[%p]  ################  POOL %p", p, p);
             } else {
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+                AutoreleasePoolEntry *entry = (AutoreleasePoolEntry *)p;
+                id obj = (id)entry->ptr;
+                if (entry->count > 0) {
+                    _objc_inform("[%p]  %#16lx  %s  autorelease count %u", 
+                                 p, (unsigned long)obj, 
+                                 object_getClassName(obj), 
+                                 (unsigned)entry->count + 1);
+                    continue;
+                }
+#else
+                id obj = *p;
+#endif
                 _objc_inform("[%p]  %#16lx  %s", 
-                             p, (unsigned long)*p, object_getClassName(*p));
+                             p, (unsigned long)obj, object_getClassName(obj));
             }
         }
     }
@@ -1618,30 +1950,50 @@ public:
         _objc_inform("##############");
     }
 
+    static void statistics(objc_autoreleasepool_statistics *stats)
+    {
+        bzero(stats, sizeof(*stats));
+        stats->pageSize = SIZE;
+
+        AutoreleasePoolPage *hot = hotPage();
+        if (!hot) return;
+
+        updateHiwat();
+        stats->hiwat = hot->hiwat;
+        for (AutoreleasePoolPage *p = hot; p; p = p->parent) {
+            stats->pages++;
+            stats->entries += p->next - p->begin();
+        }
+        for (AutoreleasePoolPage *p = hot->child; p; p = p->child) {
+            stats->cachedPages++;
+        }
+    }
+
+    // Check and propagate the high water mark.
+    // Returns the new mark, or 0 if it did not grow.
+    static uint32_t updateHiwat()
+    {
+        AutoreleasePoolPage *p = hotPage();
+        if (!p) return 0;
+
+        uint32_t mark = p->depth*(uint32_t)COUNT() + (uint32_t)(p->next - p->begin());
+        if (fastpath(mark <= p->hiwat)) return 0;
+
+        for( ; p; p = p->parent) {
+            p->unprotect();
+            p->hiwat = mark;
+            p->protect();
+        }
+        return mark;
+    }
+
     __attribute__((noinline, cold))
     static void printHiwat()
     {
-        // Check and propagate high water mark
         // Ignore high water marks under 256 to suppress noise.
-        // 检查并传播 high water 忽略 256 以下的 high water 以抑制噪音。
-        AutoreleasePoolPage *p = hotPage();
-        // COUNT 固定情况下是 4096 / 8 = 512
-       // p->depth 是 hotPage 的深度，第一个 page 的 depth 是 0，
-       // 然后每次增加一个 page 该 page 的 depth 加 1
-       // p->next - p->begin() 是该 page 内存储的 autorelease 对象的个数
-       // 那么 mark 大概就是从第一个 page 到 hotpage 的 page
-       // 的数量乘以 512 然后加上 hotPage 里面保存的 autorelease 对象的数量
-        
-        uint32_t mark = p->depth*COUNT + (uint32_t)(p->next - p->begin());
-        // 如果 mark 大于 p->hiwat 并且 mark 大于 256
-        if (mark > p->hiwat  &&  mark > 256) {
-            // 沿着 parent 链遍历每个 page，把每个 page 的 hiwat 置为 mark
-            for( ; p; p = p->parent) {
-                p->unprotect(); // 可读可写
-                p->hiwat = mark; // 修改 hiwat 为 mark
-                p->protect(); // 只可读
-            }
-
+        // 忽略 256 以下的 high water 以抑制噪音。
+        uint32_t mark = updateHiwat();
+        if (mark > 256) {
             _objc_inform("POOL HIGHWATER: new high water mark of %u "
                          "pending releases for thread %p:",
                          mark, objc_thread_self());
@@ -1680,6 +2032,8 @@ public:
 #undef POOL_BOUNDARY
 };
 
+size_t AutoreleasePoolPage::SIZE = AutoreleasePoolPage::DEFAULT_SIZE;
+
 /***********************************************************************
 * Slow paths for inline control
 **********************************************************************/
@@ -1700,6 +2054,95 @@ objc_object::rootRelease_underflow(bool performDealloc)
 }
 
 
+// rootRetain(false, true) for a caller that already holds 
+// this object's side table lock.
+void
+objc_object::rootRetain_sidetableLocked()
+{
+    ASSERT(isa.nonpointer);
+
+    bool transcribeToSideTable;
+    isa_t oldisa;
+    isa_t newisa;
+
+    do {
+        transcribeToSideTable = false;
+        oldisa = LoadExclusive(&isa.bits);
+        newisa = oldisa;
+        uintptr_t carry;
+        newisa.bits = addc(newisa.bits, RC_ONE, 0, &carry);  // extra_rc++
+        if (slowpath(carry)) {
+            // Leave half of the retain counts inline and 
+            // copy the other half to the side table.
+            transcribeToSideTable = true;
+            newisa.extra_rc = RC_HALF;
+            newisa.has_sidetable_rc = true;
+        }
+    } while (slowpath(!StoreExclusive(&isa.bits, oldisa.bits, newisa.bits)));
+
+    if (transcribeToSideTable) sidetable_addExtraRC_nolock(RC_HALF);
+}
+
+
+// rootRelease(false, true) for a caller that already holds 
+// this object's side table lock, short of deallocating.
+// Returns false and changes nothing if this release would deallocate; 
+// the caller must then release normally after dropping the lock.
+bool
+objc_object::rootRelease_sidetableLocked()
+{
+    ASSERT(isa.nonpointer);
+
+    isa_t oldisa;
+    isa_t newisa;
+
+ retry:
+    do {
+        oldisa = LoadExclusive(&isa.bits);
+        newisa = oldisa;
+        uintptr_t carry;
+        newisa.bits = subc(newisa.bits, RC_ONE, 0, &carry);  // extra_rc--
+        if (slowpath(carry)) {
+            // don't ClearExclusive()
+            goto underflow;
+        }
+    } while (slowpath(!StoreReleaseExclusive(&isa.bits, 
+                                             oldisa.bits, newisa.bits)));
+    return true;
+
+ underflow:
+    newisa = oldisa;
+
+    size_t borrowed = 
+        newisa.has_sidetable_rc ? sidetable_subExtraRC_nolock(RC_HALF) : 0;
+    if (borrowed == 0) {
+        ClearExclusive(&isa.bits);
+        return false;
+    }
+
+    // Same as the borrow in rootRelease().
+    newisa.extra_rc = borrowed - 1;  // redo the original decrement too
+    bool stored = StoreReleaseExclusive(&isa.bits, oldisa.bits, newisa.bits);
+    if (!stored) {
+        isa_t oldisa2 = LoadExclusive(&isa.bits);
+        isa_t newisa2 = oldisa2;
+        uintptr_t overflow;
+        newisa2.bits = 
+            addc(newisa2.bits, RC_ONE * (borrowed-1), 0, &overflow);
+        if (!overflow) {
+            stored = StoreReleaseExclusive(&isa.bits, oldisa2.bits, 
+                                           newisa2.bits);
+        }
+    }
+
+    if (!stored) {
+        sidetable_addExtraRC_nolock(borrowed);
+        goto retry;
+    }
+    return true;
+}
+
+
 // Slow path of clearDeallocating() 
 // for objects with nonpointer isa
 // that were ever weakly referenced 
@@ -1727,6 +2170,10 @@ objc_object::clearDeallocating_slow()
     }
     // 解锁
     table.unlock();
+
+    // Lock-free weak and atomic property loads 
+    // may still hold pointers to this object.
+    if (isa.weakly_referenced) weak_wait_for_readers();
 }
 
 #endif
@@ -1891,6 +2338,293 @@ objc_object::sidetable_getExtraRC_nolock()
 }
 
 
+#if SUPPORT_BIASED_REFCOUNT
+
+/***********************************************************************
+* Biased reference counting (OBJC_ENABLE_BIASED_REFCOUNT)
+*
+* A newly allocated object is adopted by its allocating thread, which 
+* keeps a private count of its references in a small thread-local 
+* table. Retains and releases on the owning thread touch only that 
+* count and take no atomics. Other threads retain and release the 
+* shared (isa + side table) count as usual.
+*
+* While an object is adopted, the allocation's +1 stays in the shared 
+* count on behalf of the owner. Counts:
+*   references = shared - 1 + count - remote
+* where remote counts releases that other threads handed to the owner.
+* A release that would take the shared count to zero first checks 
+* whether the object is adopted; if so it bumps remote instead of 
+* deallocating (biased_remoteRelease()).
+*
+* When count == remote the owner merges: it closes the entry, so no 
+* further remote releases are accepted, and releases the shared +1 
+* normally, deallocating the object if that was the last reference. 
+* The owner checks for this on its own releases, and for all its 
+* entries when an autorelease pool is popped and at thread exit, so 
+* an object released last by another thread is deallocated at the 
+* owner's next pool pop.
+*
+* Tables are direct-mapped; an allocation whose slot is taken simply 
+* isn't adopted. Tables are never freed. A table whose thread has 
+* exited is emptied and handed to the next thread that needs one.
+**********************************************************************/
+
+struct biased_rc_entry {
+    explicit_atomic<objc_object *> obj;
+    uintptr_t count;                      // owning thread only
+    explicit_atomic<uintptr_t> remote;    // (remote releases << 1) | closed
+};
+
+enum {
+    BIASED_RC_ENTRIES = 64,
+    BIASED_RC_CLOSED = 1,
+};
+
+struct biased_rc_table {
+    biased_rc_entry entries[BIASED_RC_ENTRIES];
+    explicit_atomic<bool> inUse;
+    biased_rc_table *next;
+};
+
+static tls_key_t biased_rc_key;
+static bool biased_rc_ready;
+static explicit_atomic<biased_rc_table *> biased_rc_tables{nil};
+
+static inline unsigned biased_rc_index(objc_object *obj)
+{
+    return ((uintptr_t)obj >> 4) & (BIASED_RC_ENTRIES - 1);
+}
+
+static biased_rc_table *biased_rc_register(void)
+{
+    biased_rc_table *table;
+
+    for (table = biased_rc_tables.load(std::memory_order_acquire);
+         table;
+         table = table->next)
+    {
+        bool expected = false;
+        if (!table->inUse.load(std::memory_order_relaxed)  &&
+            table->inUse.compare_exchange_strong(expected, true,
+                                                 std::memory_order_acquire))
+        {
+            tls_set(biased_rc_key, table);
+            return table;
+        }
+    }
+
+    table = (biased_rc_table *)calloc(1, sizeof(biased_rc_table));
+    table->inUse.store(true, std::memory_order_relaxed);
+    auto head = biased_rc_tables.load(std::memory_order_relaxed);
+    do {
+        table->next = head;
+    } while (!biased_rc_tables.compare_exchange_weak
+             (head, table, std::memory_order_release,
+              std::memory_order_relaxed));
+
+    tls_set(biased_rc_key, table);
+    return table;
+}
+
+static inline biased_rc_entry *
+biased_rc_entryFor(objc_object *obj)
+{
+    if (slowpath(!biased_rc_ready)) return nil;
+
+    auto table = (biased_rc_table *)tls_get(biased_rc_key);
+    if (!table) return nil;
+    auto entry = &table->entries[biased_rc_index(obj)];
+    if (entry->obj.load(std::memory_order_relaxed) != obj) return nil;
+    return entry;
+}
+
+// Close the entry if the owner's references are all gone.
+// Returns true if it closed the entry; the caller then releases the 
+// shared +1. Returns false if the owner still has references, or if 
+// biased_forget() already closed the entry.
+static bool biased_rc_tryClose(biased_rc_entry *entry)
+{
+    uintptr_t remote = entry->remote.load(std::memory_order_acquire);
+    do {
+        if (remote & BIASED_RC_CLOSED) return false;
+        if (entry->count > (remote >> 1)) return false;
+    } while (!entry->remote.compare_exchange_weak
+             (remote, remote | BIASED_RC_CLOSED, std::memory_order_acq_rel));
+    entry->obj.store(nil, std::memory_order_release);
+    return true;
+}
+
+// Merge every entry whose references are all gone.
+static void biased_rc_drain(biased_rc_table *table)
+{
+    for (unsigned i = 0; i < BIASED_RC_ENTRIES; i++) {
+        auto entry = &table->entries[i];
+        objc_object *obj = entry->obj.load(std::memory_order_relaxed);
+        if (obj  &&  biased_rc_tryClose(entry)) {
+            obj->release();
+        }
+    }
+}
+
+static void biased_rc_thread_exit(void *arg)
+{
+    auto table = (biased_rc_table *)arg;
+
+    // Hand the remaining references over to the shared count.
+    // The table is no longer this thread's (see tls_get), 
+    // so these retains and releases go straight to it.
+    for (unsigned i = 0; i < BIASED_RC_ENTRIES; i++) {
+        auto entry = &table->entries[i];
+        objc_object *obj = entry->obj.load(std::memory_order_relaxed);
+        if (!obj) continue;
+        // Freed by biased_forget() without being released.
+        uintptr_t remote = entry->remote.load(std::memory_order_acquire);
+        if (remote & BIASED_RC_CLOSED) continue;
+
+        // Add every local reference first, so no remote release 
+        // can find the shared count at zero once the entry is closed.
+        for (uintptr_t n = entry->count; n > 0; n--) obj->rootRetain();
+        remote = 
+            entry->remote.fetch_or(BIASED_RC_CLOSED, std::memory_order_acq_rel);
+        if (remote & BIASED_RC_CLOSED) continue;
+        entry->obj.store(nil, std::memory_order_release);
+        // Then drop the releases other threads queued, and the +1 held 
+        // on the owner's behalf.
+        for (uintptr_t n = (remote >> 1) + 1; n > 0; n--) obj->release();
+    }
+
+    table->inUse.store(false, std::memory_order_release);
+}
+
+static void biased_rc_pool_pop(void)
+{
+    if (slowpath(!biased_rc_ready)) return;
+    auto table = (biased_rc_table *)tls_get(biased_rc_key);
+    if (table) biased_rc_drain(table);
+}
+
+void
+objc_object::biased_adopt()
+{
+    ASSERT(isa.nonpointer);
+    if (slowpath(!biased_rc_ready)) return;
+
+    auto table = (biased_rc_table *)tls_get(biased_rc_key);
+    if (!table) table = biased_rc_register();
+
+    auto entry = &table->entries[biased_rc_index(this)];
+    objc_object *old = entry->obj.load(std::memory_order_relaxed);
+    // The slot is taken by another live object. Leave this one shared.
+    // An entry for this same address was left by an object disposed 
+    // while still adopted, and is simply reused.
+    if (old  &&  old != this) return;
+
+    entry->count = 1;
+    entry->remote.store(0, std::memory_order_relaxed);
+    entry->obj.store(this, std::memory_order_release);
+}
+
+// Called when this object is destroyed. An object released to zero 
+// was merged by its owner first (see biased_remoteRelease()), but one 
+// freed by object_dispose() without being released may still be 
+// adopted by any thread. Close its entry the way a remote release 
+// would, so the owner neither merges it nor keeps the address.
+void
+objc_object::biased_forget()
+{
+    if (slowpath(!biased_rc_ready)) return;
+    if (!isa.nonpointer  ||  isa.deallocating) return;
+
+    unsigned index = biased_rc_index(this);
+    for (auto table = biased_rc_tables.load(std::memory_order_acquire);
+         table;
+         table = table->next)
+    {
+        auto entry = &table->entries[index];
+        if (entry->obj.load(std::memory_order_acquire) != this) continue;
+
+        uintptr_t remote = entry->remote.load(std::memory_order_relaxed);
+        do {
+            // The owner closed it first and is merging.
+            if (remote & BIASED_RC_CLOSED) return;
+        } while (!entry->remote.compare_exchange_weak
+                 (remote, remote | BIASED_RC_CLOSED, 
+                  std::memory_order_acq_rel));
+        entry->obj.store(nil, std::memory_order_release);
+        return;
+    }
+}
+
+bool
+objc_object::biased_retain()
+{
+    auto entry = biased_rc_entryFor(this);
+    if (!entry) return false;
+    entry->count++;
+    return true;
+}
+
+bool
+objc_object::biased_release(bool performDealloc, bool *deallocated)
+{
+    auto entry = biased_rc_entryFor(this);
+    if (!entry) return false;
+
+    entry->count--;
+    if (!biased_rc_tryClose(entry)) {
+        *deallocated = false;
+        return true;
+    }
+
+    // The owner is done. Merge by releasing the shared +1.
+    *deallocated = rootRelease(performDealloc, false);
+    return true;
+}
+
+// Called by a thread whose release would drop the shared count to zero.
+// Returns true if the object is adopted by a thread, which now owns 
+// the release.
+bool
+objc_object::biased_remoteRelease()
+{
+    if (slowpath(!biased_rc_ready)) return false;
+
+    unsigned index = biased_rc_index(this);
+    for (auto table = biased_rc_tables.load(std::memory_order_acquire);
+         table;
+         table = table->next)
+    {
+        auto entry = &table->entries[index];
+        if (entry->obj.load(std::memory_order_acquire) != this) continue;
+
+        uintptr_t remote = entry->remote.load(std::memory_order_relaxed);
+        do {
+            // The owner is handing its references back to the shared 
+            // count, which changes the isa. The caller's store will 
+            // fail and retry.
+            if (remote & BIASED_RC_CLOSED) return false;
+        } while (!entry->remote.compare_exchange_weak
+                 (remote, remote + 2, std::memory_order_acq_rel));
+        return true;
+    }
+    return false;
+}
+
+// The owner's references beyond the one shared count held for them.
+intptr_t
+objc_object::biased_extraCount()
+{
+    auto entry = biased_rc_entryFor(this);
+    if (!entry) return 0;
+    uintptr_t remote = entry->remote.load(std::memory_order_relaxed) >> 1;
+    return (intptr_t)(entry->count - remote) - 1;
+}
+
+// SUPPORT_BIASED_REFCOUNT
+#endif
+
+
 // SUPPORT_NONPOINTER_ISA
 #endif
 
@@ -2111,6 +2845,179 @@ objc_autorelease(id obj)
 }
 
 
+/***********************************************************************
+* objc_retainArray
+* objc_releaseArray
+* Retain or release every object in an array, skipping nil and tagged 
+* pointers. Objects that need their SideTable - those whose retain 
+* count lives only in the side table, and nonpointer isa objects whose 
+* retain overflows extra_rc or whose release borrows back from the 
+* side table - are collected and sorted by SideTable, so each table is 
+* locked once per batch instead of once per object. Nonpointer objects 
+* still update their isa with one CAS each, under the table lock as 
+* rootRetain() and rootRelease() do. Other objects take the same inline 
+* path as objc_retain() and objc_release() without the call overhead.
+* Objects released to zero in a batch are deallocated after the side 
+* table locks are dropped.
+**********************************************************************/
+
+namespace {
+struct rr_batch_entry {
+    SideTable *table;
+    objc_object *obj;
+};
+}
+
+enum { RR_BATCH_COUNT = 128 };
+
+// Objects that can join a side table batch: default RR, and either 
+// raw isa and not a class (classes ignore retain and release), or 
+// nonpointer isa about to overflow to or borrow from the side table.
+static ALWAYS_INLINE bool
+rr_batchable(objc_object *obj, bool release)
+{
+    if (fastpath(obj->hasNonpointerIsa())) {
+#if SUPPORT_NONPOINTER_ISA
+        bool sidetable = release ? obj->rootReleaseWouldBorrow() 
+                                 : obj->rootRetainWouldOverflow();
+        return sidetable  &&  !obj->ISA()->hasCustomRR();
+#else
+        return false;
+#endif
+    }
+    Class cls = obj->ISA();
+    return !cls->isMetaClass()  &&  !cls->hasCustomRR();
+}
+
+// Sort the batch by side table and call fn for each entry 
+// with its table locked.
+template <typename Fn>
+static void
+rr_batch_apply(rr_batch_entry *batch, unsigned count, const Fn& fn)
+{
+    std::sort(batch, batch + count, 
+              [](const rr_batch_entry& a, const rr_batch_entry& b) {
+        return a.table < b.table;
+    });
+
+    for (unsigned i = 0; i < count; ) {
+        SideTable *table = batch[i].table;
+        table->lock();
+        do {
+            fn(*table, batch[i].obj);
+        } while (++i < count  &&  batch[i].table == table);
+        table->unlock();
+    }
+}
+
+static void
+rr_batch_retain(rr_batch_entry *batch, unsigned count)
+{
+    rr_batch_apply(batch, count, [](SideTable& table, objc_object *obj) {
+#if SUPPORT_NONPOINTER_ISA
+        // The table lock keeps the isa from changing between 
+        // nonpointer and raw pointer.
+        if (obj->hasNonpointerIsa()) {
+            obj->rootRetain_sidetableLocked();
+            return;
+        }
+#endif
+        size_t& refcntStorage = table.refcnts[obj];
+        if (! (refcntStorage & SIDE_TABLE_RC_PINNED)) {
+            refcntStorage += SIDE_TABLE_RC_ONE;
+        }
+    });
+}
+
+static void
+rr_batch_release(rr_batch_entry *batch, unsigned count)
+{
+    objc_object *dead[RR_BATCH_COUNT];
+    unsigned deadCount = 0;
+    objc_object *unbatched[RR_BATCH_COUNT];
+    unsigned unbatchedCount = 0;
+
+    rr_batch_apply(batch, count, [&](SideTable& table, objc_object *obj) {
+#if SUPPORT_NONPOINTER_ISA
+        if (obj->hasNonpointerIsa()) {
+            // Deallocating needs the full release path.
+            if (!obj->rootRelease_sidetableLocked()) {
+                unbatched[unbatchedCount++] = obj;
+            }
+            return;
+        }
+#endif
+        // Same as sidetable_release().
+        auto it = table.refcnts.try_emplace(obj, SIDE_TABLE_DEALLOCATING);
+        auto &refcnt = it.first->second;
+        if (it.second) {
+            dead[deadCount++] = obj;
+        } else if (refcnt < SIDE_TABLE_DEALLOCATING) {
+            // SIDE_TABLE_WEAKLY_REFERENCED may be set. Don't change it.
+            dead[deadCount++] = obj;
+            refcnt |= SIDE_TABLE_DEALLOCATING;
+        } else if (! (refcnt & SIDE_TABLE_RC_PINNED)) {
+            refcnt -= SIDE_TABLE_RC_ONE;
+        }
+    });
+
+    for (unsigned i = 0; i < unbatchedCount; i++) {
+        unbatched[i]->rootRelease();
+    }
+    for (unsigned i = 0; i < deadCount; i++) {
+        ((void(*)(objc_object *, SEL))objc_msgSend)(dead[i], @selector(dealloc));
+    }
+}
+
+void
+objc_retainArray(id *objs, size_t count)
+{
+    rr_batch_entry batch[RR_BATCH_COUNT];
+    unsigned batched = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        id obj = objs[i];
+        if (!obj  ||  obj->isTaggedPointer()) continue;
+
+        if (slowpath(rr_batchable(obj, false))) {
+            batch[batched++] = { &SideTables()[obj], obj };
+            if (batched == RR_BATCH_COUNT) {
+                rr_batch_retain(batch, batched);
+                batched = 0;
+            }
+        } else {
+            obj->retain();
+        }
+    }
+
+    if (batched) rr_batch_retain(batch, batched);
+}
+
+void
+objc_releaseArray(id *objs, size_t count)
+{
+    rr_batch_entry batch[RR_BATCH_COUNT];
+    unsigned batched = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        id obj = objs[i];
+        if (!obj  ||  obj->isTaggedPointer()) continue;
+
+        if (slowpath(rr_batchable(obj, true))) {
+            batch[batched++] = { &SideTables()[obj], obj };
+            if (batched == RR_BATCH_COUNT) {
+                rr_batch_release(batch, batched);
+                batched = 0;
+            }
+        } else {
+            obj->release();
+        }
+    }
+
+    if (batched) rr_batch_release(batch, batched);
+}
+
+
 // OBJC2
 #else
 // not OBJC2
@@ -2120,6 +3027,14 @@ id objc_retain(id obj) { return [obj retain]; }
 void objc_release(id obj) { [obj release]; }
 id objc_autorelease(id obj) { return [obj autorelease]; }
 
+void objc_retainArray(id *objs, size_t count) {
+    for (size_t i = 0; i < count; i++) [objs[i] retain];
+}
+
+void objc_releaseArray(id *objs, size_t count) {
+    for (size_t i = 0; i < count; i++) [objs[i] release];
+}
+
 
 #endif
 
@@ -2374,6 +3289,9 @@ void
 objc_autoreleasePoolPop(void *ctxt)
 {
     AutoreleasePoolPage::pop(ctxt);
+#if SUPPORT_BIASED_REFCOUNT
+    if (slowpath(EnableBiasedRefcount)) biased_rc_pool_pop();
+#endif
 }
 
 
@@ -2395,6 +3313,12 @@ _objc_autoreleasePoolPrint(void)
     AutoreleasePoolPage::printAll();
 }
 
+void
+objc_autoreleasePoolGetStatistics(objc_autoreleasepool_statistics *stats)
+{
+    AutoreleasePoolPage::statistics(stats);
+}
+
 
 // Same as objc_release but suitable for tail-calling 
 // if you need the value back and don't want to push a frame before this point.
@@ -2483,7 +3407,16 @@ void arr_init(void)
 {
     AutoreleasePoolPage::init();
     SideTablesMap.init();
-    _objc_associations_init();
+#if SUPPORT_NONPOINTER_ISA
+    weak_reader_key = tls_create(&weak_reader_thread_exit);
+    weak_readers_ready = true;
+#endif
+#if SUPPORT_BIASED_REFCOUNT
+    if (EnableBiasedRefcount) {
+        biased_rc_key = tls_create(&biased_rc_thread_exit);
+        biased_rc_ready = true;
+    }
+#endif
 }
 
 
@@ -43,6 +43,50 @@ StripedMap<spinlock_t> PropertyLocks;
 StripedMap<spinlock_t> StructLocks;
 StripedMap<spinlock_t> CppObjectLocks;
 
+// Version counters for the StructLocks stripes. A writer holds the 
+// stripe's lock and keeps the version odd while it writes. Readers 
+// copy without the lock and retry if the version changed meanwhile.
+struct StructVersion {
+    std::atomic<uintptr_t> version;
+
+    constexpr StructVersion() : version(0) { }
+
+    uintptr_t readBegin() {
+        uintptr_t v;
+        while ((v = version.load(std::memory_order_acquire)) & 1) {
+            sched_yield();
+        }
+        return v;
+    }
+
+    bool readRetry(uintptr_t v) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return version.load(std::memory_order_relaxed) != v;
+    }
+
+    void writeBegin() {
+        version.store(version.load(std::memory_order_relaxed) + 1, 
+                      std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void writeEnd() {
+        version.store(version.load(std::memory_order_relaxed) + 1, 
+                      std::memory_order_release);
+    }
+};
+static StripedMap<StructVersion> StructVersions;
+
+// Memory on this thread's stack is not shared with other threads 
+// (the compiler-generated struct getters copy into a local).
+static inline bool isOnCurrentStack(const void *p)
+{
+    pthread_t self = objc_thread_self();
+    uintptr_t top = (uintptr_t)pthread_get_stackaddr_np(self);
+    uintptr_t bottom = top - pthread_get_stacksize_np(self);
+    return (uintptr_t)p >= bottom  &&  (uintptr_t)p < top;
+}
+
 #define MUTABLE_COPY 2
 
 
@@ -57,8 +101,15 @@ id objc_getProperty(id self, SEL _cmd, ptrdiff_t offset, BOOL atomic) {
     // Retain release world
     id *slot = (id*) ((char*)self + offset);
     if (!atomic) return *slot; //nonatomic
-        
+
     // Atomic retain release world
+#if SUPPORT_NONPOINTER_ISA
+    bool handled = true;
+    id result = property_loadRetained_lockFree(slot, &handled);
+    if (fastpath(handled)) return objc_autoreleaseReturnValue(result);
+#endif
+
+    // Values with raw isa or custom RR take the lock.
     //atomic进行加锁
     spinlock_t& slotlock = PropertyLocks[slot];
     slotlock.lock();
@@ -113,6 +164,10 @@ static inline void reallySetProperty(id self, SEL _cmd, id newValue, ptrdiff_t o
         oldValue = *slot;
         *slot = newValue;        
         slotlock.unlock();
+#if SUPPORT_NONPOINTER_ISA
+        // Lock-free getters may be about to retain oldValue.
+        property_retire(slot, oldValue);
+#endif
     }
 
     objc_release(oldValue);
@@ -147,25 +202,56 @@ void objc_setProperty_nonatomic_copy(id self, SEL _cmd, id newValue, ptrdiff_t o
 }
 
 
-// This entry point was designed wrong.  When used as a getter, src needs to be locked so that
-// if simultaneously used for a setter then there would be contention on src.
-// So we need two locks - one of which will be contended.
+// This entry point was designed wrong. It is used both as a getter and 
+// as a setter, so it cannot tell which side is the shared ivar. 
+// Writes to dest serialize on dest's lock and bump its version. 
+// A src on another stack or the heap is read optimistically against 
+// its version when dest is on this thread's stack. Otherwise src's 
+// lock is taken too: waiting for src's version while holding dest's 
+// version odd deadlocks against a thread copying the other way.
 void objc_copyStruct(void *dest, const void *src, ptrdiff_t size, BOOL atomic, BOOL hasStrong __unused) {
-    spinlock_t *srcLock = nil;
-    spinlock_t *dstLock = nil;
-    if (atomic) {
-        srcLock = &StructLocks[src];
-        dstLock = &StructLocks[dest];
-        spinlock_t::lockTwo(srcLock, dstLock);
+    if (!atomic) {
+        memmove(dest, src, size);
+        return;
     }
 
-    memmove(dest, src, size);
+    // Memory on this thread's stack has no other readers or writers.
+    bool dstShared = !isOnCurrentStack(dest);
+    bool srcShared = !isOnCurrentStack(src);
 
-    if (atomic) {
-        spinlock_t::unlockTwo(srcLock, dstLock);
+    if (!dstShared) {
+        if (srcShared) {
+            // A torn copy into this stack is simply retried.
+            StructVersion& version = StructVersions[src];
+            uintptr_t v;
+            do {
+                v = version.readBegin();
+                memmove(dest, src, size);
+            } while (version.readRetry(v));
+        } else {
+            memmove(dest, src, size);
+        }
+        return;
     }
+
+    spinlock_t *dstLock = &StructLocks[dest];
+    spinlock_t *srcLock = srcShared ? &StructLocks[src] : dstLock;
+    StructVersion& dstVersion = StructVersions[dest];
+
+    // Holding src's lock excludes its writers, so src is not read 
+    // optimistically here. The struct may be too large to stage on 
+    // the stack, so both locks are taken in lockTwo's order instead.
+    spinlock_t::lockTwo(srcLock, dstLock);
+
+    dstVersion.writeBegin();
+    memmove(dest, src, size);
+    dstVersion.writeEnd();
+
+    spinlock_t::unlockTwo(srcLock, dstLock);
 }
 
+// C++ objects keep both locks. A copy constructor cannot be run 
+// optimistically on a source that another thread is modifying.
 void objc_copyCppObjectAtomic(void *dest, const void *src, void (*copyHelper) (void *dest, const void *source)) {
     spinlock_t *srcLock = &CppObjectLocks[src];
     spinlock_t *dstLock = &CppObjectLocks[dest];
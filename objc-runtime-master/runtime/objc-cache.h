@@ -14,10 +14,22 @@ extern void cache_fill(Class cls, SEL sel, IMP imp, id receiver);
 
 extern void cache_erase_nolock(Class cls);
 
+extern void cache_evict_nolock(Class cls, SEL sel, IMP imp);
+
 extern void cache_delete(Class cls);
 
 extern void cache_collect(bool collectALot);
 
+// Cache readers and lock-free method lookup bracket their reads with these.
+extern void cache_epoch_enter(void);
+extern void cache_epoch_exit(void);
+
+// Frees memory once no reader inside an epoch can still see it.
+extern void cache_epoch_retire(void *ptr, size_t size);
+
+// Frees retired memory that readers have moved past, if they have.
+extern bool cache_epoch_try_advance(void);
+
 __END_DECLS
 
 #endif
@@ -72,6 +72,14 @@
  * cache_flush        (only called from cache_fill and flush_caches)
  * cache_collect_free (only called from cache_expand and cache_flush)
  *
+ * With CONFIG_USE_CACHE_EPOCHS, cache readers instead publish the 
+ * current cache epoch in a per-thread record for the duration of the 
+ * probe (cache_epoch_enter/cache_epoch_exit). Garbage is tagged with 
+ * the epoch it was retired in and is freed once every active reader 
+ * has moved two epochs past it. No thread is ever suspended and garbage 
+ * is reclaimed a little at a time. This is only safe if every messenger 
+ * publishes; a messenger that does not (Win32) never frees garbage.
+ *
  * UNPROTECTED cache readers (NOT thread-safe; used for debug info only)
  * cache_print
  * _class_printMethodCaches
@@ -85,6 +93,7 @@
 
 #include "objc-private.h"
 #include "objc-cache.h"
+#include "DenseMapExtras.h"
 
 
 /* Initial cache bucket count. INIT_CACHE_SIZE must be a power of two. */
@@ -97,8 +106,10 @@ enum {
 
 
 static void cache_collect_free(struct bucket_t *data, mask_t capacity);
+#if !CONFIG_USE_CACHE_EPOCHS
 static int _collecting_in_critical(void);
 static void _garbage_make_room(void);
+#endif
 
 #if DEBUG_TASK_THREADS
 static kern_return_t objc_task_threads
@@ -137,6 +148,54 @@ static void recordDeadCache(mask_t capacity)
     }
 }
 
+/***********************************************************************
+* Cache statistics for objc_cache_copyStatistics
+* These are always on. Each counter is updated on a cache fill or 
+* reallocation, which already holds cacheUpdateLock, so they need no 
+* extra synchronization and cost nothing on the objc_msgSend fast path.
+**********************************************************************/
+struct cache_class_statistics {
+    size_t misses;
+    size_t reallocations;
+};
+
+static objc::LazyInitDenseMap<Class, cache_class_statistics> cache_class_stats;
+static size_t cache_reallocations;
+static size_t cache_probe_lengths[OBJC_CACHE_PROBE_HISTOGRAM_COUNT];
+
+static cache_class_statistics& statisticsForClass(Class cls)
+{
+    return (*cache_class_stats.get(true))[cls];
+}
+
+static void recordCacheMiss(Class cls)
+{
+    statisticsForClass(cls).misses++;
+}
+
+static void recordCacheReallocation(Class cls)
+{
+    statisticsForClass(cls).reallocations++;
+    cache_reallocations++;
+}
+
+static void recordCacheProbe(mask_t probes)
+{
+    if (probes >= OBJC_CACHE_PROBE_HISTOGRAM_COUNT) {
+        probes = OBJC_CACHE_PROBE_HISTOGRAM_COUNT - 1;
+    }
+    cache_probe_lengths[probes]++;
+}
+
+static void forgetCacheStatistics(Class cls)
+{
+    if (auto map = cache_class_stats.get(false)) {
+        map->erase(cls);
+    }
+}
+
+static size_t cache_garbage_bytes(void);
+
 /***********************************************************************
 * Pointers used by compiled class objects
 * These use asm to avoid conflicts with the compiler's internal declarations
@@ -259,6 +318,8 @@ cache_t *getCache(Class cls)
     return &cls->cache;
 }
 
+const uint8_t bucket_t::evictedSelStorage = 0;
+
 #if __arm64__
 
 template<Atomicity atomicity, IMPEncoding impEncoding>
@@ -581,26 +642,80 @@ bool cache_t::canBeFreed()
 {
     return !isConstantEmptyCache();
 }
+
+
+/***********************************************************************
+* cache_t::copyBuckets
+* Rehash every live entry of oldBuckets into newBuckets, which must be 
+* freshly allocated, unpublished, and larger than oldBuckets.
+* Returns the number of entries copied.
+* Cache locks: cacheUpdateLock must be held by the caller.
+**********************************************************************/
+mask_t cache_t::copyBuckets(Class cls,
+                            bucket_t *oldBuckets, mask_t oldCapacity,
+                            bucket_t *newBuckets, mask_t newCapacity)
+{
+    ASSERT(newCapacity > oldCapacity);
+
+    mask_t m = newCapacity - 1;
+    mask_t copied = 0;
+
+    // The end marker, if any, is the last old bucket and is skipped.
+    for (mask_t i = 0; i < oldCapacity - CACHE_END_MARKER; i++) {
+        if (!oldBuckets[i].isLive()) continue;
+        SEL sel = oldBuckets[i].sel();
+
+        // IMPs are signed with the bucket address, so decode 
+        // from the old bucket and re-encode into the new one.
+        IMP imp = oldBuckets[i].imp(cls);
+        mask_t begin = cache_hash(sel, m);
+        mask_t j = begin;
+        do {
+            if (newBuckets[j].sel() == 0) {
+                newBuckets[j].set<NotAtomic, Encoded>(sel, imp, cls);
+                copied++;
+                break;
+            }
+        } while ((j = cache_next(j, m)) != begin);
+    }
+
+    return copied;
+}
+
 #pragma mark - 开辟缓存空间
 /// 开辟缓存空间
 /// @param oldCapacity 旧的容量
 /// @param newCapacity 新的容量
 /// @param freeOld 是否释放旧的缓存
+/// @param copyOld 是否将旧缓存的内容重新哈希到新的buckets
 ALWAYS_INLINE
-void cache_t::reallocate(mask_t oldCapacity, mask_t newCapacity, bool freeOld)
+void cache_t::reallocate(Class cls, mask_t oldCapacity, mask_t newCapacity,
+                         bool freeOld, bool copyOld)
 {
     bucket_t *oldBuckets = buckets();
     //新开辟内存空间
     bucket_t *newBuckets = allocateBuckets(newCapacity);
 
-    // Cache's old contents are not propagated. 
-    // This is thought to save cache memory at the cost of extra cache fills.
-    // fixme re-measure this
-
     ASSERT(newCapacity > 0);
     ASSERT((uintptr_t)(mask_t)(newCapacity-1) == newCapacity-1);
+
+    // When growing, rehash the old contents into the new buckets so 
+    // the class does not pay a full round of cache misses on every 
+    // doubling. The new buckets are not visible to objc_msgSend until 
+    // setBucketsAndMask() below, so they can be filled non-atomically.
+    // Same-size reallocations (e.g. at MAX_CACHE_SIZE) start empty 
+    // because a full table cannot be copied into itself.
+    mask_t copied = 0;
+    if (copyOld  &&  newCapacity > oldCapacity) {
+        copied = copyBuckets(cls, oldBuckets, oldCapacity, 
+                             newBuckets, newCapacity);
+    }
+
     //储存新的buckets,和mask(newCapacity - 1)
-    setBucketsAndMask(newBuckets, newCapacity - 1);
+    setBucketsAndMask(newBuckets, newCapacity - 1); // also clears occupied
+    _occupied = copied;
+
+    recordCacheReallocation(cls);
     
     if (freeOld) {
         //释放旧的内存空间
@@ -678,7 +793,7 @@ void cache_t::insert(Class cls, SEL sel, IMP imp, id receiver)
         // Cache is read-only. Replace it.
         //开辟空间 1<<2,4个空间
         if (!capacity) capacity = INIT_CACHE_SIZE;
-        reallocate(oldCapacity, capacity, /* freeOld */false);
+        reallocate(cls, oldCapacity, capacity, /* freeOld */false, /* copyOld */false);
     }
     else if (fastpath(newOccupied + CACHE_END_MARKER <= capacity / 4 * 3)) {
         // Cache is less than 3/4 full. Use it as-is.
@@ -690,14 +805,15 @@ void cache_t::insert(Class cls, SEL sel, IMP imp, id receiver)
         if (capacity > MAX_CACHE_SIZE) {
             capacity = MAX_CACHE_SIZE; //最大容量 1<<16
         }
-        //扩容
-        reallocate(oldCapacity, capacity, true);
+        //扩容,保留旧缓存内容
+        reallocate(cls, oldCapacity, capacity, /* freeOld */true, /* copyOld */true);
     }
 
     bucket_t *b = buckets();
     mask_t m = capacity - 1;
     mask_t begin = cache_hash(sel, m); //哈希函数 (mask_t)(uintptr_t)sel & mask
     mask_t i = begin;
+    mask_t probes = 0;
 
     // Scan for the first unused slot and insert there.
     // There is guaranteed to be an empty slot because the
@@ -708,6 +824,7 @@ void cache_t::insert(Class cls, SEL sel, IMP imp, id receiver)
             //插入位置没有冲突
             incrementOccupied(); // _occupied++,已占用+1
             b[i].set<Atomic, Encoded>(sel, imp, cls); //添加缓存
+            recordCacheProbe(probes);
             return;
         }
         if (b[i].sel() == sel) {
@@ -716,6 +833,7 @@ void cache_t::insert(Class cls, SEL sel, IMP imp, id receiver)
             return;
         }
         //有冲突,再次进行哈希,计算出新的位置,直到没有冲突位置
+        probes++;
     } while (fastpath((i = cache_next(i, m)) != begin));
 
     cache_t::bad_cache(receiver, (SEL)sel, cls);
@@ -733,6 +851,7 @@ void cache_fill(Class cls, SEL sel, IMP imp, id receiver)
 #if CONFIG_USE_CACHE_LOCK
         mutex_locker_t lock(cacheUpdateLock);
 #endif
+        recordCacheMiss(cls);
         cache->insert(cls, sel, imp, receiver);
     }
 #else
@@ -764,6 +883,36 @@ void cache_erase_nolock(Class cls)
 }
 
 
+// Evict sel from this cache if it is cached with the given IMP.
+// Other entries stay cached. Used when a single method's IMP changes.
+void cache_evict_nolock(Class cls, SEL sel, IMP imp)
+{
+#if CONFIG_USE_CACHE_LOCK
+    cacheUpdateLock.assertLocked();
+#else
+    runtimeLock.assertLocked();
+#endif
+
+    cache_t *cache = getCache(cls);
+    if (cache->occupied() == 0) return;
+
+    bucket_t *b = cache->buckets();
+    mask_t m = cache->mask();
+    mask_t begin = cache_hash(sel, m);
+    mask_t i = begin;
+
+    // insert() never stores a selector twice, so stop at the first match.
+    do {
+        SEL s = b[i].sel();
+        if (s == 0) return;
+        if (s == sel) {
+            if (b[i].imp(cls) == imp) b[i].evict();
+            return;
+        }
+    } while ((i = cache_next(i, m)) != begin);
+}
+
+
 void cache_delete(Class cls)
 {
 #if CONFIG_USE_CACHE_LOCK
@@ -775,6 +924,7 @@ void cache_delete(Class cls)
         if (PrintCaches) recordDeadCache(cls->cache.capacity());
         free(cls->cache.buckets());
     }
+    forgetCacheStatistics(cls);
 }
 
 
@@ -782,6 +932,295 @@ void cache_delete(Class cls)
 * cache collection.
 **********************************************************************/
 
+/***********************************************************************
+* cache_print_statistics.  Log the live cache histogram.
+**********************************************************************/
+static void cache_print_statistics(void)
+{
+    size_t i;
+    size_t total_count = 0;
+    size_t total_size = 0;
+
+    for (i = 0; i < countof(cache_counts); i++) {
+        int count = cache_counts[i];
+        int slots = 1 << i;
+        size_t size = count * slots * sizeof(bucket_t);
+
+        if (!count) continue;
+
+        _objc_inform("CACHES: %4d slots: %4d caches, %6zu bytes", 
+                     slots, count, size);
+
+        total_count += count;
+        total_size += size;
+    }
+
+    _objc_inform("CACHES:      total: %4zu caches, %6zu bytes", 
+                 total_count, total_size);
+}
+
+/***********************************************************************
+* Epoch-based reclamation.
+*
+* cache_epoch counts up by one each time every active reader has been 
+* observed in the current epoch. A reader's record holds 0 while it is 
+* outside the cache, or (epoch << 1) | 1 while it is probing.
+*
+* Garbage retired during epoch E is filed in epoch_garbage[E % 3].
+* When the epoch advances to N, no reader can still be in epoch N-2, 
+* so everything retired during N-2 (= epoch_garbage[(N+1) % 3]) is 
+* unreachable and is freed. That list is then reused for epoch N+1.
+*
+* Records are never freed. A record whose thread has exited is marked 
+* unused and handed to the next thread that registers.
+*
+* The epochs exist on every platform because lock-free method lookup 
+* also reads runtime metadata under them (see cache_epoch_retire()). 
+* Only CONFIG_USE_CACHE_EPOCHS ports, whose messengers publish epochs, 
+* reclaim method caches this way.
+**********************************************************************/
+
+struct cache_epoch_record {
+    explicit_atomic<uintptr_t> state;
+    explicit_atomic<bool> inUse;
+    cache_epoch_record *next;
+};
+
+struct cache_epoch_garbage {
+    void **refs;
+    size_t count;
+    size_t max;
+    size_t bytes;
+};
+
+// capacity of initial cache_epoch_garbage.refs
+enum {
+    INIT_GARBAGE_COUNT = 128
+};
+
+static explicit_atomic<uintptr_t> cache_epoch{0};
+static explicit_atomic<cache_epoch_record *> cache_epoch_records{nil};
+static cache_epoch_garbage epoch_garbage[3];
+static tls_key_t cache_epoch_key;
+
+
+/***********************************************************************
+* cache_epoch_thread_exit.  TLS destructor. Releases the thread's 
+* record for reuse by a later thread.
+**********************************************************************/
+static void cache_epoch_thread_exit(void *arg)
+{
+    auto rec = (cache_epoch_record *)arg;
+    rec->state.store(0, std::memory_order_release);
+    rec->inUse.store(false, std::memory_order_release);
+}
+
+
+/***********************************************************************
+* cache_epoch_register.  Find or create this thread's epoch record.
+* Lock-free: it may be called from inside objc_msgSend.
+**********************************************************************/
+static cache_epoch_record *cache_epoch_register(void)
+{
+    cache_epoch_record *rec;
+
+    // Reuse a record abandoned by an exited thread.
+    for (rec = cache_epoch_records.load(std::memory_order_acquire);
+         rec;
+         rec = rec->next)
+    {
+        bool expected = false;
+        if (!rec->inUse.load(std::memory_order_relaxed)  &&
+            rec->inUse.compare_exchange_strong(expected, true,
+                                               std::memory_order_acquire))
+        {
+            tls_set(cache_epoch_key, rec);
+            return rec;
+        }
+    }
+
+    rec = (cache_epoch_record *)calloc(1, sizeof(cache_epoch_record));
+    rec->inUse.store(true, std::memory_order_relaxed);
+    auto head = cache_epoch_records.load(std::memory_order_relaxed);
+    do {
+        rec->next = head;
+    } while (!cache_epoch_records.compare_exchange_weak
+             (head, rec, std::memory_order_release, 
+              std::memory_order_relaxed));
+
+    tls_set(cache_epoch_key, rec);
+    return rec;
+}
+
+
+/***********************************************************************
+* cache_epoch_enter / cache_epoch_exit
+* Publish / retract this thread's presence in the method cache.
+* The seq_cst fence orders the publish before any load of the cache's 
+* buckets; it pairs with the fence in cache_epoch_try_advance().
+**********************************************************************/
+void cache_epoch_enter(void)
+{
+    auto rec = (cache_epoch_record *)tls_get(cache_epoch_key);
+    if (slowpath(!rec)) rec = cache_epoch_register();
+
+    uintptr_t epoch = cache_epoch.load(std::memory_order_relaxed);
+    rec->state.store((epoch << 1) | 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void cache_epoch_exit(void)
+{
+    auto rec = (cache_epoch_record *)tls_get(cache_epoch_key);
+    ASSERT(rec);
+    rec->state.store(0, std::memory_order_release);
+}
+
+
+/***********************************************************************
+* cache_epoch_free.  Free every ref in one garbage list.
+* Cache locks: cacheUpdateLock must be held by the caller.
+**********************************************************************/
+static void cache_epoch_free(cache_epoch_garbage& garbage)
+{
+    if (!garbage.count) return;
+
+    if (PrintCaches) {
+        cache_collections++;
+        _objc_inform ("CACHES: COLLECTING %zu bytes (%zu allocations, %zu collections)", garbage.bytes, cache_allocations, cache_collections);
+    }
+
+    // Erase each entry so debugging tools don't see stale pointers.
+    while (garbage.count) {
+        garbage.count--;
+        auto dead = garbage.refs[garbage.count];
+        garbage.refs[garbage.count] = nil;
+        free(dead);
+    }
+    garbage.bytes = 0;
+
+    if (PrintCaches) cache_print_statistics();
+}
+
+
+/***********************************************************************
+* cache_epoch_try_advance.  Advance the epoch if every active reader 
+* has published the current one, and free the garbage that became 
+* unreachable. Returns false if some reader is still behind.
+* Callers that retire memory outside the method cache call this 
+* afterwards, so their garbage doesn't wait for a cache to be freed.
+* Cache locks: cacheUpdateLock must be held by the caller.
+**********************************************************************/
+bool cache_epoch_try_advance(void)
+{
+    uintptr_t epoch = cache_epoch.load(std::memory_order_relaxed);
+
+    // Order the caller's unpublishing of old buckets before the scan.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    for (auto rec = cache_epoch_records.load(std::memory_order_acquire);
+         rec;
+         rec = rec->next)
+    {
+        uintptr_t state = rec->state.load(std::memory_order_acquire);
+        if (state  &&  (state >> 1) != epoch) return false;
+    }
+
+    cache_epoch.store(epoch + 1, std::memory_order_release);
+    cache_epoch_free(epoch_garbage[(epoch + 2) % 3]);
+    return true;
+}
+
+
+/***********************************************************************
+* cache_epoch_retire.  Free ptr once no thread inside an epoch can 
+* still be reading it. size is only used for statistics.
+* Locking: runtimeLock must be held by the caller.
+**********************************************************************/
+void cache_epoch_retire(void *ptr, size_t size)
+{
+    runtimeLock.assertLocked();
+
+    if (!ptr) return;
+
+    uintptr_t epoch = cache_epoch.load(std::memory_order_relaxed);
+    auto& garbage = epoch_garbage[epoch % 3];
+    if (garbage.count == garbage.max) {
+        garbage.max = garbage.max ? garbage.max * 2 : INIT_GARBAGE_COUNT;
+        garbage.refs = (void **)
+            realloc(garbage.refs, garbage.max * sizeof(void *));
+    }
+    garbage.refs[garbage.count++] = ptr;
+    garbage.bytes += size;
+}
+
+
+#if CONFIG_USE_CACHE_EPOCHS
+
+void cache_init()
+{
+    cache_epoch_key = tls_create(&cache_epoch_thread_exit);
+}
+
+
+static size_t cache_garbage_bytes(void)
+{
+    return epoch_garbage[0].bytes + epoch_garbage[1].bytes + 
+        epoch_garbage[2].bytes;
+}
+
+
+/***********************************************************************
+* cache_collect_free.  Retire the specified malloc'd memory into the 
+* current epoch's garbage and try to reclaim older garbage.
+* Cache locks: cacheUpdateLock must be held by the caller.
+**********************************************************************/
+static void cache_collect_free(bucket_t *data, mask_t capacity)
+{
+#if CONFIG_USE_CACHE_LOCK
+    cacheUpdateLock.assertLocked();
+#else
+    runtimeLock.assertLocked();
+#endif
+
+    if (PrintCaches) recordDeadCache(capacity);
+
+    cache_epoch_retire(data, cache_t::bytesForCapacity(capacity));
+    cache_collect(false);
+}
+
+
+/***********************************************************************
+* cache_collect.  Try to free accumulated dead caches.
+* There is no size threshold: each call advances the epoch when it can.
+* collectALot waits until every retired cache has been freed.
+* Cache locks: cacheUpdateLock must be held by the caller.
+**********************************************************************/
+void cache_collect(bool collectALot)
+{
+#if CONFIG_USE_CACHE_LOCK
+    cacheUpdateLock.assertLocked();
+#else
+    runtimeLock.assertLocked();
+#endif
+
+    if (!collectALot) {
+        if (!cache_epoch_try_advance()  &&  PrintCaches) {
+            _objc_inform ("CACHES: not collecting; "
+                          "objc_msgSend in progress");
+        }
+    }
+    else {
+        // No excuses. Three advances flush all three garbage lists.
+        for (int advanced = 0; advanced < 3; ) {
+            if (cache_epoch_try_advance()) advanced++;
+        }
+    }
+}
+
+// CONFIG_USE_CACHE_EPOCHS
+#else
+
 #if !TARGET_OS_WIN32
 
 // A sentinel (magic value) to report bad thread_get_state status.
@@ -852,6 +1291,8 @@ static bool shouldUseRestartableRanges = true;
 
 void cache_init()
 {
+    cache_epoch_key = tls_create(&cache_epoch_thread_exit);
+
 #if HAVE_TASK_RESTARTABLE_RANGES
     mach_msg_type_number_t count = 0;
     kern_return_t kr;
@@ -977,6 +1418,11 @@ enum {
     INIT_GARBAGE_COUNT = 128
 };
 
+static size_t cache_garbage_bytes(void)
+{
+    return garbage_byte_size;
+}
+
 static void _garbage_make_room(void)
 {
     static int first = 1;
@@ -1037,6 +1483,9 @@ void cache_collect(bool collectALot)
     runtimeLock.assertLocked();
 #endif
 
+    // Metadata retired by lock-free lookup uses epochs even here.
+    cache_epoch_try_advance();
+
     // Done if the garbage is not full
     if (garbage_byte_size < garbage_threshold  &&  !collectALot) {
         return;
@@ -1080,28 +1529,63 @@ void cache_collect(bool collectALot)
     garbage_count = 0;
     garbage_byte_size = 0;
 
-    if (PrintCaches) {
-        size_t i;
-        size_t total_count = 0;
-        size_t total_size = 0;
+    if (PrintCaches) cache_print_statistics();
+}
+
+// !CONFIG_USE_CACHE_EPOCHS
+#endif
 
-        for (i = 0; i < countof(cache_counts); i++) {
-            int count = cache_counts[i];
-            int slots = 1 << i;
-            size_t size = count * slots * sizeof(bucket_t);
 
-            if (!count) continue;
+/***********************************************************************
+* objc_cache_copyStatistics
+* Returns per-class method cache statistics and fills in process totals.
+*
+* outTotals and outCount may be nil. *outCount is the number of entries 
+* returned. If the returned array is not nil, it must be freed with free().
+* Locking: acquires cacheUpdateLock
+**********************************************************************/
+objc_cache_class_statistics *
+objc_cache_copyStatistics(objc_cache_statistics *outTotals, 
+                          unsigned int *outCount)
+{
+    objc_cache_class_statistics *result = nil;
+    unsigned int count = 0;
 
-            _objc_inform("CACHES: %4d slots: %4d caches, %6zu bytes", 
-                         slots, count, size);
+#if CONFIG_USE_CACHE_LOCK
+    mutex_locker_t lock(cacheUpdateLock);
+#else
+    mutex_locker_t lock(runtimeLock);
+#endif
 
-            total_count += count;
-            total_size += size;
+    if (outTotals) {
+        outTotals->reallocations = cache_reallocations;
+        outTotals->garbageBytes = cache_garbage_bytes();
+        for (unsigned i = 0; i < OBJC_CACHE_PROBE_HISTOGRAM_COUNT; i++) {
+            outTotals->probeLengths[i] = cache_probe_lengths[i];
         }
+    }
 
-        _objc_inform("CACHES:      total: %4zu caches, %6zu bytes", 
-                     total_count, total_size);
+    if (auto map = cache_class_stats.get(false)) {
+        count = (unsigned int)map->size();
     }
+
+    if (count > 0) {
+        unsigned int i = 0;
+        result = (objc_cache_class_statistics *)
+            calloc(count, sizeof(objc_cache_class_statistics));
+        for (auto& entry : *cache_class_stats.get(false)) {
+            Class cls = entry.first;
+            result[i].cls = cls;
+            result[i].misses = entry.second.misses;
+            result[i].reallocations = entry.second.reallocations;
+            result[i].capacity = cls->cache.capacity();
+            result[i].occupied = cls->cache.occupied();
+            i++;
+        }
+    }
+
+    if (outCount) *outCount = count;
+    return result;
 }
 
 
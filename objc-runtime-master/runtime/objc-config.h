@@ -115,6 +115,15 @@
 #   define SUPPORT_NONPOINTER_ISA 1
 #endif
 
+// Define SUPPORT_BIASED_REFCOUNT=1 to let OBJC_ENABLE_BIASED_REFCOUNT give 
+// the allocating thread a private, non-atomic retain count for new objects.
+// It piggybacks on the nonpointer isa retain count.
+#if SUPPORT_NONPOINTER_ISA
+#   define SUPPORT_BIASED_REFCOUNT 1
+#else
+#   define SUPPORT_BIASED_REFCOUNT 0
+#endif
+
 // Define SUPPORT_FIXUP=1 to repair calls sites for fixup dispatch.
 // Fixup messaging itself is no longer supported.
 // Be sure to edit objc-abi.h as well (objc_msgSend*_fixup)
@@ -170,6 +179,14 @@
 #   define HAVE_TASK_RESTARTABLE_RANGES 1
 #endif
 
+// Define CONFIG_USE_CACHE_EPOCHS=1 to reclaim dead method caches using
+// per-thread epochs published by cache readers, instead of suspending
+// threads and checking their PCs. Only a port whose objc_msgSend and
+// cache_getImp bracket their cache probe with cache_epoch_enter() and
+// cache_epoch_exit() may define it. No messenger in this tree does:
+// Mach platforms use task_threads(), and Win32 never frees dead caches.
+#define CONFIG_USE_CACHE_EPOCHS 0
+
 // OBJC_INSTRUMENTED controls whether message dispatching is dynamically
 // monitored.  Monitoring introduces substantial overhead.
 // NOTE: To define this condition, do so in the build command, NOT by
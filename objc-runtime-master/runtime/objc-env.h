@@ -1,6 +1,7 @@
 // -*- truncate-lines: t; -*-
 
 // OPTION(var, env, help)
+// INT_OPTION(var, env, default, help)
 
 #pragma mark - 环境变量
 OPTION( PrintImages,              OBJC_PRINT_IMAGES,               "log image and library names as they are loaded")
@@ -44,3 +45,8 @@ OPTION( DisableTaggedPointers,    OBJC_DISABLE_TAGGED_POINTERS,    "disable tagg
 OPTION( DisableTaggedPointerObfuscation, OBJC_DISABLE_TAG_OBFUSCATION,    "disable obfuscation of tagged pointers")
 OPTION( DisableNonpointerIsa,     OBJC_DISABLE_NONPOINTER_ISA,     "disable non-pointer isa fields")
 OPTION( DisableInitializeForkSafety, OBJC_DISABLE_INITIALIZE_FORK_SAFETY, "disable safety checks for +initialize after fork")
+OPTION( EnableBiasedRefcount,     OBJC_ENABLE_BIASED_REFCOUNT,     "let the allocating thread retain and release new objects without atomics")
+OPTION( DisableAutoreleaseCoalescing, OBJC_DISABLE_AUTORELEASE_COALESCING, "disable coalescing of repeated autoreleases of the same object")
+INT_OPTION( PoolPageSize,      OBJC_POOL_PAGE_SIZE,      0, "size in bytes of autorelease pool pages, a power of 2 (0 means the VM page size)")
+OPTION( DisableResolverCache,     OBJC_DISABLE_RESOLVER_CACHE,     "disable remembering selectors that +resolveInstanceMethod: and +resolveClassMethod: declined")
+OPTION( ProfileLocks,             OBJC_PROFILE_LOCKS,              "record contention for runtime locks and @synchronized; log it with _objc_lockProfilePrint()")
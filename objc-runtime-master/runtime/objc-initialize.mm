@@ -299,6 +299,12 @@ static void _finishInitializing(Class cls, Class supercls)
     cls->setInitialized();
     classInitLock.notifyAll();
     _setThisThreadIsNotInitializingClass(cls);
+
+#if __OBJC2__
+    // Here rather than after +initialize returns, so subclasses whose 
+    // completion waited for this class get their caches too.
+    preloadCachesFromProfile(cls);
+#endif
     
     // mark any subclasses that were merely waiting for this class
     if (!pendingInitializeMap) return;
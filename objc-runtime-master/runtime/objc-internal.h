@@ -160,6 +160,47 @@ OBJC_EXPORT
 objc_imp_cache_entry *_Nullable
 class_copyImpCache(Class _Nonnull cls, int * _Nullable outCount)
 	OBJC_AVAILABLE(10.15, 13.0, 13.0, 6.0, 5.0);
+
+// Method cache statistics.
+// probeLengths[i] counts cache fills that landed i slots away from
+// their hash bucket. The last entry also counts all longer probes.
+#define OBJC_CACHE_PROBE_HISTOGRAM_COUNT 16
+
+typedef struct objc_cache_class_statistics {
+    Class _Nonnull cls;
+    unsigned long misses;         // slow-path lookups that filled the cache
+    unsigned long reallocations;  // times the cache was (re)allocated
+    unsigned int capacity;        // current bucket count
+    unsigned int occupied;        // current live entries
+} objc_cache_class_statistics;
+
+typedef struct objc_cache_statistics {
+    unsigned long reallocations;  // total over all classes
+    unsigned long garbageBytes;   // dead caches waiting to be freed
+    unsigned long probeLengths[OBJC_CACHE_PROBE_HISTOGRAM_COUNT];
+} objc_cache_statistics;
+
+// Returns one entry per class whose cache has been filled.
+// The result must be freed with free().
+OBJC_EXPORT
+objc_cache_class_statistics *_Nullable
+objc_cache_copyStatistics(objc_cache_statistics * _Nullable outTotals,
+                          unsigned int * _Nullable outCount)
+	OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
+// Method cache profiles.
+// objc_cache_writeProfile records the selectors in every realized 
+// class's method cache. objc_cache_loadProfile reads such a profile in 
+// a later process and fills the same caches up front. IMPs are looked 
+// up afresh, so a profile from an older build is safe to load.
+OBJC_EXPORT bool
+objc_cache_writeProfile(const char * _Nonnull path)
+	OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
+// Returns the number of cache entries scheduled for preloading.
+OBJC_EXPORT unsigned int
+objc_cache_loadProfile(const char * _Nonnull path)
+	OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
 #endif
 
 // Plainly-implemented GC barriers. Rosetta used to use these.
@@ -681,6 +722,21 @@ void
 objc_autoreleasePoolPop(void * _Nonnull context)
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
 
+// Autorelease pool statistics for the current thread.
+// Entries are pool slots; a slot may hold several autoreleases 
+// of one object.
+typedef struct objc_autoreleasepool_statistics {
+    size_t pageSize;              // bytes per pool page
+    unsigned int pages;           // pages holding this thread's pools
+    unsigned int cachedPages;     // empty pages kept for reuse
+    unsigned long entries;        // entries waiting to be released
+    unsigned long hiwat;          // high water mark, as OBJC_PRINT_POOL_HIGHWATER reports it
+} objc_autoreleasepool_statistics;
+
+OBJC_EXPORT void
+objc_autoreleasePoolGetStatistics(objc_autoreleasepool_statistics * _Nonnull stats)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
 
 OBJC_EXPORT id _Nullable
 objc_alloc(Class _Nullable cls)
@@ -734,6 +790,16 @@ objc_autorelease(id _Nullable obj)
     __asm__("_objc_autorelease")
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
 
+// Retain or release each of objs[0..count). nil and tagged pointers 
+// are skipped. Cheaper than one objc_retain or objc_release per object.
+OBJC_EXPORT void
+objc_retainArray(id _Nullable * _Nonnull objs, size_t count)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
+OBJC_EXPORT void
+objc_releaseArray(id _Nullable * _Nonnull objs, size_t count)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
 // Prepare a value at +1 for return through a +0 autoreleasing convention.
 OBJC_EXPORT id _Nullable
 objc_autoreleaseReturnValue(id _Nullable obj)
@@ -771,6 +837,19 @@ OBJC_EXPORT id _Nullable
 objc_loadWeakRetained(id _Nullable * _Nonnull location)
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
 
+// Weak reference table statistics, summed over all side tables.
+typedef struct objc_weak_table_statistics {
+    unsigned long tables;           // side tables
+    unsigned long entries;          // weakly referenced objects
+    unsigned long capacity;         // hash slots, including arrays being resized
+    unsigned long maxDisplacement;  // longest probe sequence in any table
+    unsigned long resizing;         // tables in the middle of a resize
+} objc_weak_table_statistics;
+
+OBJC_EXPORT void
+objc_weak_getStatistics(objc_weak_table_statistics * _Nonnull stats)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
 OBJC_EXPORT id _Nullable 
 objc_initWeak(id _Nullable * _Nonnull location, id _Nullable val)
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
@@ -806,6 +885,11 @@ OBJC_EXPORT void
 _objc_autoreleasePoolPrint(void)
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
 
+// Logs lock contention recorded with OBJC_PROFILE_LOCKS=YES.
+OBJC_EXPORT void
+_objc_lockProfilePrint(void)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
 OBJC_EXPORT BOOL
 objc_should_deallocate(id _Nonnull object)
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
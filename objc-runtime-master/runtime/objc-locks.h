@@ -44,7 +44,7 @@ extern recursive_mutex_t loadMethodLock;
 extern mutex_t crashlog_lock;
 extern spinlock_t objcMsgLogLock;
 extern mutex_t AltHandlerDebugLock;
-extern mutex_t AssociationsManagerLock;
+extern StripedMap<spinlock_t> AssociationsManagerLocks;
 extern StripedMap<spinlock_t> PropertyLocks;
 extern StripedMap<spinlock_t> StructLocks;
 extern StripedMap<spinlock_t> CppObjectLocks;
@@ -58,6 +58,7 @@ extern void SideTableLocksPrecedeLock(const void *newlock);
 extern void SideTableLocksSucceedLock(const void *oldlock);
 extern void SideTableLocksPrecedeLocks(StripedMap<spinlock_t>& newlocks);
 extern void SideTableLocksSucceedLocks(StripedMap<spinlock_t>& oldlocks);
+extern void SideTableLocksProfile();
 
 #if __OBJC2__
 #include "objc-locks-new.h"
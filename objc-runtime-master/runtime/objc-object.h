@@ -491,6 +491,9 @@ objc_object::retain()
 ALWAYS_INLINE id 
 objc_object::rootRetain()
 {
+#if SUPPORT_BIASED_REFCOUNT
+    if (slowpath(EnableBiasedRefcount)  &&  biased_retain()) return (id)this;
+#endif
     return rootRetain(false, false);
 }
 
@@ -558,6 +561,26 @@ objc_object::rootRetain(bool tryRetain, bool handleOverflow)
 }
 
 
+// Returns true if the next retain will move counts to the side table.
+// The answer may be stale by the time the caller acts on it.
+inline bool
+objc_object::rootRetainWouldOverflow()
+{
+    isa_t bits = isa;
+    return bits.nonpointer  &&  bits.extra_rc == (RC_HALF << 1) - 1;
+}
+
+
+// Returns true if the next release will borrow counts from the side table.
+// The answer may be stale by the time the caller acts on it.
+inline bool
+objc_object::rootReleaseWouldBorrow()
+{
+    isa_t bits = isa;
+    return bits.nonpointer  &&  bits.extra_rc == 0  &&  bits.has_sidetable_rc;
+}
+
+
 // Equivalent to calling [this release], with shortcuts if there is no override
 inline void
 objc_object::release()
@@ -586,12 +609,24 @@ objc_object::release()
 ALWAYS_INLINE bool 
 objc_object::rootRelease()
 {
+#if SUPPORT_BIASED_REFCOUNT
+    bool deallocated;
+    if (slowpath(EnableBiasedRefcount)  &&  biased_release(true, &deallocated)) {
+        return deallocated;
+    }
+#endif
     return rootRelease(true, false);
 }
 
 ALWAYS_INLINE bool 
 objc_object::rootReleaseShouldDealloc()
 {
+#if SUPPORT_BIASED_REFCOUNT
+    bool deallocated;
+    if (slowpath(EnableBiasedRefcount)  &&  biased_release(false, &deallocated)) {
+        return deallocated;
+    }
+#endif
     return rootRelease(false, false);
 }
 
@@ -601,6 +636,9 @@ objc_object::rootRelease(bool performDealloc, bool handleUnderflow)
     if (isTaggedPointer()) return false;
 
     bool sideTableLocked = false;
+#if SUPPORT_BIASED_REFCOUNT
+    bool biasedChecked = false;
+#endif
 
     isa_t oldisa;
     isa_t newisa;
@@ -708,6 +746,21 @@ objc_object::rootRelease(bool performDealloc, bool handleUnderflow)
         return overrelease_error();
         // does not actually return
     }
+
+#if SUPPORT_BIASED_REFCOUNT
+    if (slowpath(EnableBiasedRefcount)  &&  !biasedChecked) {
+        // The last shared reference may belong to an owning thread's 
+        // local references. If so, that thread finishes the release.
+        // Check once, outside the exclusive monitor, then start over.
+        ClearExclusive(&isa.bits);
+        if (biased_remoteRelease()) {
+            if (slowpath(sideTableLocked)) sidetable_unlock();
+            return false;
+        }
+        biasedChecked = true;
+        goto retry;
+    }
+#endif
     newisa.deallocating = true;
     if (!StoreExclusive(&isa.bits, oldisa.bits, newisa.bits)) goto retry;
 
@@ -766,6 +819,13 @@ objc_object::rootRetainCount()
             rc += sidetable_getExtraRC_nolock();
         }
         sidetable_unlock();
+#if SUPPORT_BIASED_REFCOUNT
+        // The owning thread also sees its own count. One shared 
+        // count stands for all of it. Other threads only see that one.
+        if (slowpath(EnableBiasedRefcount)) {
+            rc += biased_extraCount();
+        }
+#endif
         return rc;
     }
 
@@ -739,6 +739,18 @@ extern const fork_unsafe_lock_t fork_unsafe_lock;
 
 #include "objc-lockdebug.h"
 
+// Lock contention profiling (OBJC_PROFILE_LOCKS).
+// lockprofile_enabled is set once the profiled locks are registered. 
+// Locks that were not registered are ignored by the lockprofile calls.
+extern bool lockprofile_enabled;
+extern void lockprofile_register(const void *lock, const char *name, int index);
+extern void lockprofile_lock(const void *lock, os_unfair_lock *mLock, 
+                             os_unfair_lock_options_t opts);
+extern void lockprofile_locked(const void *lock);
+extern void lockprofile_unlock(const void *lock);
+extern void lockprofile_sync_locked(Class cls, bool contended, uint64_t waitNanos);
+extern void lockprofile_sync_unlocked(Class cls, uint64_t holdNanos);
+
 template <bool Debug>
 class mutex_tt : nocopy_t {
     os_unfair_lock mLock;
@@ -754,13 +766,27 @@ class mutex_tt : nocopy_t {
 
         // <rdar://problem/50384154>
         uint32_t opts = OS_UNFAIR_LOCK_DATA_SYNCHRONIZATION | OS_UNFAIR_LOCK_ADAPTIVE_SPIN;
+        if (slowpath(lockprofile_enabled)) {
+            lockprofile_lock(this, &mLock, (os_unfair_lock_options_t)opts);
+            return;
+        }
         os_unfair_lock_lock_with_options_inline
             (&mLock, (os_unfair_lock_options_t)opts);
     }
 
+    bool tryLock() {
+        if (os_unfair_lock_trylock(&mLock)) {
+            lockdebug_mutex_lock(this);
+            if (slowpath(lockprofile_enabled)) lockprofile_locked(this);
+            return true;
+        }
+        return false;
+    }
+
     void unlock() {
         lockdebug_mutex_unlock(this);
 
+        if (slowpath(lockprofile_enabled)) lockprofile_unlock(this);
         os_unfair_lock_unlock_inline(&mLock);
     }
 
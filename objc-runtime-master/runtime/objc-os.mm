@@ -415,6 +415,234 @@ static bool shouldRejectGCImage(const headerType *mhdr)
 #endif
 
 
+/***********************************************************************
+* Lock contention profiling
+* With OBJC_PROFILE_LOCKS=YES, runtimeLock, the SideTable stripes, 
+* the PropertyLocks stripes, and the AssociationsManagerLocks stripes 
+* record acquisitions, contended acquisitions, total wait time, and 
+* maximum hold time. @synchronized records the same per class of the 
+* synchronized object. _objc_lockProfilePrint() logs both, sorted by 
+* total wait time.
+* The records never take a lock themselves because they are updated 
+* from inside mutex_tt::lock() and unlock().
+**********************************************************************/
+
+struct lockprofile_record_t {
+    std::atomic<const void *> key;  // lock address, or Class for @synchronized
+    const char *name;               // nil for @synchronized
+    int index;                      // stripe index, or -1
+    std::atomic<uint64_t> acquisitions;
+    std::atomic<uint64_t> contended;
+    std::atomic<uint64_t> waitNanos;
+    std::atomic<uint64_t> maxHoldNanos;
+    uint64_t lockedAt;              // written only by the lock's owner
+
+    void noteHold(uint64_t hold) {
+        uint64_t max = maxHoldNanos.load(std::memory_order_relaxed);
+        while (hold > max  &&  
+               !maxHoldNanos.compare_exchange_weak(max, hold, std::memory_order_relaxed))
+            ;
+    }
+};
+
+struct lockprofile_table_t {
+    lockprofile_record_t *records;
+    uint32_t mask;
+
+    void init(uint32_t size) {
+        records = (lockprofile_record_t *)calloc(size, sizeof(lockprofile_record_t));
+        mask = size - 1;
+    }
+
+    // Returns nil if key is absent and create is false, or if the table is full.
+    lockprofile_record_t *find(const void *key, bool create) {
+        uint32_t index = ptr_hash((uintptr_t)key) & mask;
+        for (uint32_t probes = 0; probes <= mask; probes++) {
+            lockprofile_record_t *record = &records[index];
+            const void *k = record->key.load(std::memory_order_acquire);
+            if (k == key) return record;
+            if (!k) {
+                if (!create) return nil;
+                if (record->key.compare_exchange_strong(k, key, std::memory_order_acq_rel)) {
+                    return record;
+                }
+                if (k == key) return record;
+            }
+            index = (index + 1) & mask;
+        }
+        return nil;
+    }
+};
+
+#define LOCKPROFILE_LOCK_TABLE_SIZE  4096
+#define LOCKPROFILE_CLASS_TABLE_SIZE 1024
+
+bool lockprofile_enabled;
+static lockprofile_table_t lockprofile_locks;
+static lockprofile_table_t lockprofile_classes;
+
+void lockprofile_register(const void *lock, const char *name, int index)
+{
+    lockprofile_record_t *record = lockprofile_locks.find(lock, true);
+    if (record) {
+        record->name = name;
+        record->index = index;
+    }
+}
+
+static void lockprofile_register_stripes(StripedMap<spinlock_t>& locks, 
+                                         const char *name)
+{
+    int i = 0;
+    const void *lock;
+    while ((lock = locks.getLock(i))) {
+        lockprofile_register(lock, name, i++);
+    }
+}
+
+static void lockprofile_init()
+{
+    if (!ProfileLocks) return;
+
+    lockprofile_locks.init(LOCKPROFILE_LOCK_TABLE_SIZE);
+    lockprofile_classes.init(LOCKPROFILE_CLASS_TABLE_SIZE);
+
+#if __OBJC2__
+    lockprofile_register(&runtimeLock, "runtimeLock", -1);
+#endif
+    SideTableLocksProfile();
+    lockprofile_register_stripes(PropertyLocks, "PropertyLocks");
+    lockprofile_register_stripes(AssociationsManagerLocks, "AssociationsManagerLocks");
+
+    lockprofile_enabled = true;
+}
+
+void lockprofile_lock(const void *lock, os_unfair_lock *mLock, 
+                      os_unfair_lock_options_t opts)
+{
+    lockprofile_record_t *record = lockprofile_locks.find(lock, false);
+    if (!record) {
+        os_unfair_lock_lock_with_options_inline(mLock, opts);
+        return;
+    }
+
+    if (os_unfair_lock_trylock(mLock)) {
+        record->acquisitions.fetch_add(1, std::memory_order_relaxed);
+        record->lockedAt = nanoseconds();
+        return;
+    }
+
+    uint64_t start = nanoseconds();
+    os_unfair_lock_lock_with_options_inline(mLock, opts);
+    uint64_t now = nanoseconds();
+    record->acquisitions.fetch_add(1, std::memory_order_relaxed);
+    record->contended.fetch_add(1, std::memory_order_relaxed);
+    record->waitNanos.fetch_add(now - start, std::memory_order_relaxed);
+    record->lockedAt = now;
+}
+
+void lockprofile_locked(const void *lock)
+{
+    lockprofile_record_t *record = lockprofile_locks.find(lock, false);
+    if (record) {
+        record->acquisitions.fetch_add(1, std::memory_order_relaxed);
+        record->lockedAt = nanoseconds();
+    }
+}
+
+void lockprofile_unlock(const void *lock)
+{
+    lockprofile_record_t *record = lockprofile_locks.find(lock, false);
+    // lockedAt is zero if the lock was taken before profiling started.
+    if (record  &&  record->lockedAt) {
+        record->noteHold(nanoseconds() - record->lockedAt);
+        record->lockedAt = 0;
+    }
+}
+
+void lockprofile_sync_locked(Class cls, bool contended, uint64_t waitNanos)
+{
+    lockprofile_record_t *record = lockprofile_classes.find(cls, true);
+    if (!record) return;
+    record->acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (contended) {
+        record->contended.fetch_add(1, std::memory_order_relaxed);
+        record->waitNanos.fetch_add(waitNanos, std::memory_order_relaxed);
+    }
+}
+
+void lockprofile_sync_unlocked(Class cls, uint64_t holdNanos)
+{
+    lockprofile_record_t *record = lockprofile_classes.find(cls, true);
+    if (record) record->noteHold(holdNanos);
+}
+
+static int lockprofile_compare(const void *a, const void *b)
+{
+    auto ra = *(lockprofile_record_t * const *)a;
+    auto rb = *(lockprofile_record_t * const *)b;
+    uint64_t wa = ra->waitNanos.load(std::memory_order_relaxed);
+    uint64_t wb = rb->waitNanos.load(std::memory_order_relaxed);
+    if (wa != wb) return wa > wb ? -1 : 1;
+    uint64_t ca = ra->contended.load(std::memory_order_relaxed);
+    uint64_t cb = rb->contended.load(std::memory_order_relaxed);
+    if (ca != cb) return ca > cb ? -1 : 1;
+    return 0;
+}
+
+static void lockprofile_print_table(lockprofile_table_t& table, bool classes)
+{
+    uint32_t size = table.mask + 1;
+    auto sorted = (lockprofile_record_t **)malloc(size * sizeof(lockprofile_record_t *));
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        lockprofile_record_t *record = &table.records[i];
+        if (record->key.load(std::memory_order_acquire)  &&  
+            record->acquisitions.load(std::memory_order_relaxed)) 
+        {
+            sorted[count++] = record;
+        }
+    }
+    qsort(sorted, count, sizeof(sorted[0]), lockprofile_compare);
+
+    for (uint32_t i = 0; i < count; i++) {
+        lockprofile_record_t *record = sorted[i];
+        char indexBuf[16] = "";
+        const char *name;
+        if (classes) {
+            name = class_getName((Class)record->key.load(std::memory_order_relaxed));
+        } else {
+            name = record->name;
+            if (record->index >= 0) {
+                snprintf(indexBuf, sizeof(indexBuf), "[%d]", record->index);
+            }
+        }
+        _objc_inform("LOCK PROFILE: %10llu acquired %10llu contended "
+                     "%12llu ns waited %12llu ns max hold  %s%s", 
+                     (unsigned long long)record->acquisitions.load(std::memory_order_relaxed), 
+                     (unsigned long long)record->contended.load(std::memory_order_relaxed), 
+                     (unsigned long long)record->waitNanos.load(std::memory_order_relaxed), 
+                     (unsigned long long)record->maxHoldNanos.load(std::memory_order_relaxed), 
+                     name, indexBuf);
+    }
+    free(sorted);
+}
+
+void _objc_lockProfilePrint(void)
+{
+    if (!lockprofile_enabled) {
+        _objc_inform("LOCK PROFILE: not enabled; set OBJC_PROFILE_LOCKS=YES");
+        return;
+    }
+    _objc_inform("LOCK PROFILE: ##############");
+    _objc_inform("LOCK PROFILE: runtime locks");
+    lockprofile_print_table(lockprofile_locks, false);
+    _objc_inform("LOCK PROFILE: @synchronized, by class of the synchronized object");
+    lockprofile_print_table(lockprofile_classes, true);
+    _objc_inform("LOCK PROFILE: ##############");
+}
+
+
 // Swift currently adds 4 callbacks.
 static GlobalSmallVector<objc_func_loadImage, 4> loadImageFuncs;
 
@@ -540,6 +768,7 @@ map_images_nolock(unsigned mhCount, const char * const mhPaths[],
     if (firstTime) {
         sel_init(selrefCount);
         arr_init();
+        lockprofile_init();
 
 #if SUPPORT_GC_COMPAT
         // Reject any GC images linked to the main executable.
@@ -701,7 +930,7 @@ static void defineLockOrder()
 #endif
     lockdebug_lock_precedes_lock(&objcMsgLogLock, &crashlog_lock);
     lockdebug_lock_precedes_lock(&AltHandlerDebugLock, &crashlog_lock);
-    lockdebug_lock_precedes_lock(&AssociationsManagerLock, &crashlog_lock);
+    AssociationsManagerLocks.precedeLock(&crashlog_lock);
     SideTableLocksPrecedeLock(&crashlog_lock);
     PropertyLocks.precedeLock(&crashlog_lock);
     StructLocks.precedeLock(&crashlog_lock);
@@ -725,20 +954,20 @@ static void defineLockOrder()
 #endif
     lockdebug_lock_precedes_lock(&loadMethodLock, &objcMsgLogLock);
     lockdebug_lock_precedes_lock(&loadMethodLock, &AltHandlerDebugLock);
-    lockdebug_lock_precedes_lock(&loadMethodLock, &AssociationsManagerLock);
+    AssociationsManagerLocks.succeedLock(&loadMethodLock);
     SideTableLocksSucceedLock(&loadMethodLock);
     PropertyLocks.succeedLock(&loadMethodLock);
     StructLocks.succeedLock(&loadMethodLock);
     CppObjectLocks.succeedLock(&loadMethodLock);
 
-    // PropertyLocks and CppObjectLocks and AssociationManagerLock 
+    // PropertyLocks and CppObjectLocks and AssociationsManagerLocks 
     // precede everything because they are held while objc_retain() 
     // or C++ copy are called.
     // (StructLocks do not precede everything because it calls memmove only.)
     auto PropertyAndCppObjectAndAssocLocksPrecedeLock = [&](const void *lock) {
         PropertyLocks.precedeLock(lock);
         CppObjectLocks.precedeLock(lock);
-        lockdebug_lock_precedes_lock(&AssociationsManagerLock, lock);
+        AssociationsManagerLocks.precedeLock(lock);
     };
 #if __OBJC2__
     PropertyAndCppObjectAndAssocLocksPrecedeLock(&runtimeLock);
@@ -759,10 +988,10 @@ static void defineLockOrder()
 
     SideTableLocksSucceedLocks(PropertyLocks);
     SideTableLocksSucceedLocks(CppObjectLocks);
-    SideTableLocksSucceedLock(&AssociationsManagerLock);
+    SideTableLocksSucceedLocks(AssociationsManagerLocks);
 
-    PropertyLocks.precedeLock(&AssociationsManagerLock);
-    CppObjectLocks.precedeLock(&AssociationsManagerLock);
+    PropertyLocks.precedeLock(AssociationsManagerLocks.getLock(0));
+    CppObjectLocks.precedeLock(AssociationsManagerLocks.getLock(0));
     
 #if __OBJC2__
     lockdebug_lock_precedes_lock(&classInitLock, &runtimeLock);
@@ -800,6 +1029,7 @@ static void defineLockOrder()
     PropertyLocks.defineLockOrder();
     StructLocks.defineLockOrder();
     CppObjectLocks.defineLockOrder();
+    AssociationsManagerLocks.defineLockOrder();
 }
 // LOCKDEBUG
 #endif
@@ -816,7 +1046,7 @@ void _objc_atfork_prepare()
     loadMethodLock.lock();
     PropertyLocks.lockAll();
     CppObjectLocks.lockAll();
-    AssociationsManagerLock.lock();
+    AssociationsManagerLocks.lockAll();
     SideTableLockAll();
     classInitLock.enter();
 #if __OBJC2__
@@ -848,7 +1078,7 @@ void _objc_atfork_parent()
     CppObjectLocks.unlockAll();
     StructLocks.unlockAll();
     PropertyLocks.unlockAll();
-    AssociationsManagerLock.unlock();
+    AssociationsManagerLocks.unlockAll();
     AltHandlerDebugLock.unlock();
     objcMsgLogLock.unlock();
     crashlog_lock.unlock();
@@ -884,7 +1114,7 @@ void _objc_atfork_child()
     CppObjectLocks.forceResetAll();
     StructLocks.forceResetAll();
     PropertyLocks.forceResetAll();
-    AssociationsManagerLock.forceReset();
+    AssociationsManagerLocks.forceResetAll();
     AltHandlerDebugLock.forceReset();
     objcMsgLogLock.forceReset();
     crashlog_lock.forceReset();
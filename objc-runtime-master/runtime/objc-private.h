@@ -143,11 +143,26 @@ public:
     bool rootReleaseShouldDealloc();
     uintptr_t rootRetainCount();
 
+#if SUPPORT_NONPOINTER_ISA
+    // Retain count overflow to the side table, batched per side table 
+    // by objc_retainArray() and objc_releaseArray()
+    bool rootRetainWouldOverflow();
+    bool rootReleaseWouldBorrow();
+    void rootRetain_sidetableLocked();
+    bool rootRelease_sidetableLocked();
+#endif
+
     // Implementation of dealloc methods
     bool rootIsDeallocating();
     void clearDeallocating();
     void rootDealloc();
 
+#if SUPPORT_BIASED_REFCOUNT
+    // Thread-owned retain count for OBJC_ENABLE_BIASED_REFCOUNT
+    void biased_adopt();
+    void biased_forget();
+#endif
+
 private:
     void initIsa(Class newCls, bool nonpointer, bool hasCxxDtor);
 
@@ -172,6 +187,13 @@ private:
     bool sidetable_addExtraRC_nolock(size_t delta_rc);
     size_t sidetable_subExtraRC_nolock(size_t delta_rc);
     size_t sidetable_getExtraRC_nolock();
+
+# if SUPPORT_BIASED_REFCOUNT
+    bool biased_retain();
+    bool biased_release(bool performDealloc, bool *deallocated);
+    bool biased_remoteRelease();
+    intptr_t biased_extraCount();
+# endif
 #endif
 
     // Side-table-only retain count
@@ -295,6 +317,21 @@ public:
 
 extern struct SafeRanges dataSegmentsRanges;
 
+#if __OBJC2__
+// Lock-free method lookup validates everything it reads against 
+// lookupSequence. Code that changes what it reads (a realized class's 
+// method lists or superclass, a method's IMP, dataSegmentsRanges) does 
+// so inside a LookupMutation, which keeps the sequence odd meanwhile.
+// LookupMutations nest. runtimeLock must be held.
+extern explicit_atomic<uintptr_t> lookupSequence;
+
+class LookupMutation : nocopy_t {
+public:
+    LookupMutation();
+    ~LookupMutation();
+};
+#endif
+
 } // objc
 
 struct header_info;
@@ -548,6 +585,7 @@ enum {
     LOOKUP_RESOLVER = 2,
     LOOKUP_CACHE = 4,
     LOOKUP_NIL = 8,
+    LOOKUP_NOFORWARD = 16,  // don't cache _objc_msgForward_impcache
 };
 extern IMP lookUpImpOrForward(id obj, SEL, Class cls, int behavior);
 
@@ -559,6 +597,10 @@ lookUpImpOrNil(id obj, SEL sel, Class cls, int behavior = 0)
 
 extern IMP lookupMethodInClassAndLoadCache(Class cls, SEL sel);
 
+#if __OBJC2__
+extern void preloadCachesFromProfile(Class cls);
+#endif
+
 struct IMPAndSEL {
     IMP imp;
     SEL sel;
@@ -643,8 +685,10 @@ extern void gdb_objc_class_changed(Class cls, unsigned long changes, const char
 
 // Settings from environment variables
 #define OPTION(var, env, help) extern bool var;
+#define INT_OPTION(var, env, default, help) extern int var;
 #include "objc-env.h"
 #undef OPTION
+#undef INT_OPTION
 
 extern void environ_init(void);
 extern void runtime_init(void);
@@ -681,9 +725,16 @@ extern char *encoding_copyArgumentType(const char *t, unsigned int index);
 
 // sync.h
 extern void _destroySyncCache(struct SyncCache *cache);
+#if SUPPORT_DIRECT_THREAD_KEYS
+extern void _objc_sync_thread_exit(void *data);
+#endif
 
 // arr
 extern void arr_init(void);
+#if SUPPORT_NONPOINTER_ISA
+extern id property_loadRetained_lockFree(id *slot, bool *handled);
+extern void property_retire(id *slot, id value);
+#endif
 extern id objc_autoreleaseReturnValue(id obj);
 
 // block trampolines
@@ -970,6 +1021,118 @@ class StripedMap {
 };
 
 
+// ScalableStripedMap<T> is a StripedMap whose stripe count is chosen 
+// when it is constructed: four stripes per online CPU, rounded up to a 
+// power of two and kept between MinStripeCount and MaxStripeCount.
+// Storage for MaxStripeCount stripes is reserved up front so that lock 
+// order can be declared before construction; only the stripes in use 
+// are constructed (and so only their pages are touched).
+template<typename T>
+class ScalableStripedMap {
+#if TARGET_OS_IPHONE && !TARGET_OS_SIMULATOR
+    enum { MinStripeCount = 8, MaxStripeCount = 64 };
+#else
+    enum { MinStripeCount = 64, MaxStripeCount = 1024 };
+#endif
+
+    struct PaddedT {
+        T value alignas(CacheLineSize);
+    };
+
+    alignas(PaddedT) uint8_t storage[sizeof(PaddedT) * MaxStripeCount];
+    unsigned int stripeCount;
+
+    PaddedT *array() {
+        return reinterpret_cast<PaddedT *>(storage);
+    }
+
+    unsigned int indexForPointer(const void *p) {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+        return ((addr >> 4) ^ (addr >> 9)) & (stripeCount - 1);
+    }
+
+    static unsigned int stripeCountForCPUs() {
+#if TARGET_OS_WIN32
+        long cpus = 0;
+#else
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        unsigned int count = MinStripeCount;
+        while (count < MaxStripeCount  &&  count < cpus * 4) count *= 2;
+        return count;
+    }
+
+ public:
+    T& operator[] (const void *p) { 
+        return array()[indexForPointer(p)].value; 
+    }
+
+    unsigned int count() const {
+        return stripeCount;
+    }
+
+    T& at(unsigned int i) {
+        ASSERT(i < stripeCount);
+        return array()[i].value;
+    }
+
+    // Shortcuts for StripedMaps of locks.
+    void lockAll() {
+        for (unsigned int i = 0; i < stripeCount; i++) {
+            array()[i].value.lock();
+        }
+    }
+
+    void unlockAll() {
+        for (unsigned int i = 0; i < stripeCount; i++) {
+            array()[i].value.unlock();
+        }
+    }
+
+    void forceResetAll() {
+        for (unsigned int i = 0; i < stripeCount; i++) {
+            array()[i].value.forceReset();
+        }
+    }
+
+    // Lock order is declared for every possible stripe because it is 
+    // declared before the stripe count is known.
+    void defineLockOrder() {
+        for (unsigned int i = 1; i < MaxStripeCount; i++) {
+            lockdebug_lock_precedes_lock(&array()[i-1].value, &array()[i].value);
+        }
+    }
+
+    void precedeLock(const void *newlock) {
+        // assumes defineLockOrder is also called
+        lockdebug_lock_precedes_lock(&array()[MaxStripeCount-1].value, newlock);
+    }
+
+    void succeedLock(const void *oldlock) {
+        // assumes defineLockOrder is also called
+        lockdebug_lock_precedes_lock(oldlock, &array()[0].value);
+    }
+
+    const void *getLock(int i) {
+        if (i < (int)stripeCount) return &array()[i].value;
+        else return nil;
+    }
+
+    ScalableStripedMap() : stripeCount(stripeCountForCPUs()) {
+        for (unsigned int i = 0; i < stripeCount; i++) {
+            new (&array()[i]) PaddedT();
+        }
+#if DEBUG
+        // Verify alignment expectations.
+        uintptr_t base = (uintptr_t)&array()[0].value;
+        uintptr_t delta = (uintptr_t)&array()[1].value - base;
+        ASSERT(delta % CacheLineSize == 0);
+        ASSERT(base % CacheLineSize == 0);
+#endif
+    }
+};
+
+
 // DisguisedPtr<T> acts like pointer type T*, except the 
 // stored value is disguised to hide it from tools like `leaks`.
 // nil is disguised as itself so zero-filled memory works as expected, 
@@ -41,8 +41,8 @@ enum {
     OBJC_ASSOCIATION_GETTER_AUTORELEASE = (2 << 8)
 };
 
-//一个全局的自旋锁（互斥锁），保证 AssociationsManager 中对 AssociationsHashMap 操作的线程安全。
-spinlock_t AssociationsManagerLock;
+// 按对象地址分片的锁，每个分片保护 AssociationsManager 中对应分片的 AssociationsHashMap。
+StripedMap<spinlock_t> AssociationsManagerLocks;
 
 #pragma mark - 关联对象的实体内容
 namespace objc {
@@ -111,8 +111,107 @@ public:
     }
 };
 /// 一个对象的表 属性名 :关联对象实体
-///key 是 const void * value 是 ObjcAssociation 的哈希表
-typedef DenseMap<const void *, ObjcAssociation> ObjectAssociationMap;
+/// Most objects have only one or two associations. Those are stored 
+/// inline in the AssociationsHashMap bucket. Adding a third key moves 
+/// every association to a heap-allocated DenseMap.
+class ObjectAssociationMap {
+    enum { InlineCount = 2 };
+    using LargeMap = DenseMap<const void *, ObjcAssociation>;
+
+    const void *_keys[InlineCount];
+    ObjcAssociation _values[InlineCount];
+    unsigned _count;     // inline entries in use; unused once _large is set
+    LargeMap *_large;
+
+    void promote() {
+        ASSERT(!_large  &&  _count == InlineCount);
+        _large = new LargeMap();
+        for (unsigned i = 0; i < _count; i++) {
+            _large->try_emplace(_keys[i], std::move(_values[i]));
+        }
+        _count = 0;
+    }
+
+public:
+    ObjectAssociationMap() : _keys{}, _count(0), _large(nil) {}
+    ObjectAssociationMap(const ObjectAssociationMap &other) = delete;
+    ObjectAssociationMap &operator=(const ObjectAssociationMap &other) = delete;
+    ObjectAssociationMap(ObjectAssociationMap &&other) : ObjectAssociationMap() {
+        swap(other);
+    }
+    ObjectAssociationMap &operator=(ObjectAssociationMap &&other) {
+        swap(other);
+        return *this;
+    }
+    ~ObjectAssociationMap() {
+        delete _large;
+    }
+
+    void swap(ObjectAssociationMap &other) {
+        for (unsigned i = 0; i < InlineCount; i++) {
+            std::swap(_keys[i], other._keys[i]);
+            _values[i].swap(other._values[i]);
+        }
+        std::swap(_count, other._count);
+        std::swap(_large, other._large);
+    }
+
+    unsigned size() const {
+        return _large ? _large->size() : _count;
+    }
+
+    ObjcAssociation *find(const void *key) {
+        if (slowpath(_large)) {
+            auto it = _large->find(key);
+            return it != _large->end() ? &it->second : nil;
+        }
+        for (unsigned i = 0; i < _count; i++) {
+            if (_keys[i] == key) return &_values[i];
+        }
+        return nil;
+    }
+
+    // Returns the association for key and whether it was newly inserted.
+    std::pair<ObjcAssociation *, bool> 
+    try_emplace(const void *key, ObjcAssociation &&value) {
+        if (ObjcAssociation *existing = find(key)) {
+            return std::make_pair(existing, false);
+        }
+        if (!_large  &&  _count < InlineCount) {
+            _keys[_count] = key;
+            _values[_count].swap(value);
+            return std::make_pair(&_values[_count++], true);
+        }
+        if (!_large) promote();
+        auto result = _large->try_emplace(key, std::move(value));
+        return std::make_pair(&result.first->second, true);
+    }
+
+    void erase(const void *key) {
+        if (slowpath(_large)) {
+            _large->erase(key);
+            return;
+        }
+        for (unsigned i = 0; i < _count; i++) {
+            if (_keys[i] == key) {
+                _count--;
+                _keys[i] = _keys[_count];
+                _values[i].swap(_values[_count]);
+                _values[_count] = ObjcAssociation();
+                return;
+            }
+        }
+    }
+
+    template <typename Fn>
+    void forEach(const Fn &call) {
+        if (slowpath(_large)) {
+            for (auto &i : *_large) call(i.second);
+            return;
+        }
+        for (unsigned i = 0; i < _count; i++) call(_values[i]);
+    }
+};
 
 /// 对象的地址:对象的所有关联对象表
 //key 是 DisguisedPtr<objc_object> value 是 ObjectAssociationMap 的哈希表
@@ -120,61 +219,67 @@ typedef DenseMap<const void *, ObjcAssociation> ObjectAssociationMap;
 typedef DenseMap<DisguisedPtr<objc_object>, ObjectAssociationMap> AssociationsHashMap;
 
 
-// class AssociationsManager manages a lock / hash table singleton pair.
-// Allocating an instance acquires the lock
+// class AssociationsManager manages the lock / hash table pair for the 
+// shard that holds one object's associations.
+// Allocating an instance acquires the shard's lock.
+// Shards are chosen by object address, so unrelated objects do not 
+// contend, and every operation on one object (including removal at 
+// dealloc) touches exactly one shard.
 #pragma mark - 关联对象管理者
 class AssociationsManager {
-    using Storage = ExplicitInitDenseMap<DisguisedPtr<objc_object>, ObjectAssociationMap>;
-    static Storage _mapStorage; //静态变量
+    using Storage = LazyInitDenseMap<DisguisedPtr<objc_object>, ObjectAssociationMap>;
+    static StripedMap<Storage> _mapStorage;
 
-public:
-    //加锁lock，并不代表唯一，只是为了避免多线程重复创建，其实在外面是可以定义多个AssociationsManager
-    AssociationsManager()   { AssociationsManagerLock.lock(); } //构造函数
-    ~AssociationsManager()  { AssociationsManagerLock.unlock(); } //析构函数
+    spinlock_t &_lock;
+    Storage &_storage;
 
-    //获取全局关联对象哈希表
-    AssociationsHashMap &get() {
-        return _mapStorage.get(); //从静态变量中获取,所以全局唯一
+public:
+    AssociationsManager(objc_object *object)
+        : _lock(AssociationsManagerLocks[object]),
+          _storage(_mapStorage[object])
+    {
+        _lock.lock();
     }
+    ~AssociationsManager()  { _lock.unlock(); }
 
-    static void init() {
-        _mapStorage.init();
+    // Returns nil if the shard has never held an association 
+    // and allowCreate is false.
+    AssociationsHashMap *get(bool allowCreate) {
+        return _storage.get(allowCreate);
     }
 };
 
-AssociationsManager::Storage AssociationsManager::_mapStorage;
+StripedMap<AssociationsManager::Storage> AssociationsManager::_mapStorage;
 
 } // namespace objc
 
 using namespace objc;
 
-void
-_objc_associations_init()
-{
-    AssociationsManager::init();
-}
-
 id
 _object_get_associative_reference(id object, const void *key)
 {
     // 局部变量
     ObjcAssociation association{};
+
+    // Objects that never had an association answer without any lock.
+    if (!object  ||  !object->hasAssociatedObjects()) return nil;
     
     {
         // 加锁
-        AssociationsManager manager;
-        // 取得全局唯一的 AssociationsHashMap
-        AssociationsHashMap &associations(manager.get());
-        // 从全局的 AssociationsHashMap 中取得对象对应的 ObjectAssociationMap
-        AssociationsHashMap::iterator i = associations.find((objc_object *)object);
-        if (i != associations.end()) {
+        AssociationsManager manager{object};
+        // 取得对象所在分片的 AssociationsHashMap
+        AssociationsHashMap *associations = manager.get(false);
+        if (!associations) return nil;
+        // 从分片的 AssociationsHashMap 中取得对象对应的 ObjectAssociationMap
+        AssociationsHashMap::iterator i = associations->find((objc_object *)object);
+        if (i != associations->end()) {
             // 如果存在
             ObjectAssociationMap &refs = i->second;
             // 从 ObjectAssocationMap 中取得 key 对应的 ObjcAssociation
-            ObjectAssociationMap::iterator j = refs.find(key);
-            if (j != refs.end()) {
+            ObjcAssociation *j = refs.find(key);
+            if (j) {
                 // 如果存在
-                association = j->second;
+                association = *j;
                 // 根据关联策略判断是否需要对 _value 执行 retain 操作
                 association.retainReturnedValue();
             }
@@ -210,9 +315,9 @@ _object_set_associative_reference(id object, const void *key, id value, uintptr_
     {
         ////初始化manager变量，相当于自动调用AssociationsManager的析构函数进行初始化
         ////并不是全局唯一，构造函数中加锁只是为了避免重复创建，在这里是可以初始化多个AssociationsManager变量
-        AssociationsManager manager;
-        // 取得全局的 AssociationsHashMap
-        AssociationsHashMap &associations(manager.get());
+        AssociationsManager manager{object};
+        // 取得对象所在分片的 AssociationsHashMap
+        AssociationsHashMap &associations(*manager.get(true));
 
         if (value) {
             // 这里 DenseMap 对我们而言是一个黑盒，这里只要看 try_emplace 函数
@@ -235,7 +340,7 @@ _object_set_associative_reference(id object, const void *key, id value, uintptr_
                 // 替换
                 // 如果之前有旧值的话把旧值的成员变量交换到 association
                 // 然后在 函数执行结束时把旧值根据对应的策略判断执行 release
-                association.swap(result.first->second);
+                association.swap(*result.first);
             }
         } else {
             // value 为 nil 的情况，表示要把之前的关联对象置为 nil
@@ -243,11 +348,11 @@ _object_set_associative_reference(id object, const void *key, id value, uintptr_
             auto refs_it = associations.find(disguised);
             if (refs_it != associations.end()) {
                 auto &refs = refs_it->second;
-                auto it = refs.find(key);
-                if (it != refs.end()) {
+                ObjcAssociation *it = refs.find(key);
+                if (it) {
                     // 清除指定的关联对象
-                    association.swap(it->second);
-                    refs.erase(it);
+                    association.swap(*it);
+                    refs.erase(key);
                     if (refs.size() == 0) {
                         // 如果当前 object 的关联对象为空了，则同时从全局的 AssociationsHashMap中移除该对象
                         associations.erase(refs_it);
@@ -258,7 +363,7 @@ _object_set_associative_reference(id object, const void *key, id value, uintptr_
         }
         // 析构 mananger 临时变量
         // 这里还有一步连带操作
-        // 在其析构函数中 AssociationsManagerLock.unlock() 解锁
+        // 在其析构函数中对分片的锁解锁
     }
 
     // release the old value (outside of the lock).
@@ -280,16 +385,18 @@ _object_remove_assocations(id object)
     ObjectAssociationMap refs{};
 
     {// 加锁
-        AssociationsManager manager;
-        // 取得全局的 AssociationsHashMap
-        AssociationsHashMap &associations(manager.get());
+        AssociationsManager manager{object};
+        // 只需要对象所在的一个分片
+        AssociationsHashMap *associations = manager.get(false);
         // 取得对象的对应 ObjectAssociationMap，里面包含所有的 (key, ObjcAssociation)
-        AssociationsHashMap::iterator i = associations.find((objc_object *)object);
-        if (i != associations.end()) {
-            // 把 i->second 的内容都转入 refs 对象中
-            refs.swap(i->second);
-            // 从全局 AssociationsHashMap 移除对象的 ObjectAssociationMap
-            associations.erase(i);
+        if (associations) {
+            AssociationsHashMap::iterator i = associations->find((objc_object *)object);
+            if (i != associations->end()) {
+                // 把 i->second 的内容都转入 refs 对象中
+                refs.swap(i->second);
+                // 从分片的 AssociationsHashMap 移除对象的 ObjectAssociationMap
+                associations->erase(i);
+            }
         }
         // 解锁
     }
@@ -297,7 +404,7 @@ _object_remove_assocations(id object)
     // release everything (outside of the lock).
     // 遍历对象的 ObjectAssociationMap 中的 (key, ObjcAssociation)
     // 对 ObjcAssociation 的 _value 根据 _policy 进行释放
-    for (auto &i: refs) {
-        i.second.releaseHeldValue();
-    }
+    refs.forEach([](ObjcAssociation &association) {
+        association.releaseHeldValue();
+    });
 }
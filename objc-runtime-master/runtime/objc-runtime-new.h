@@ -26,6 +26,9 @@
 
 #include "PointerUnion.h"
 
+// Declared in objc-cache.h, which is included after this file.
+extern "C" void cache_epoch_retire(void *ptr, size_t size);
+
 // class_data_bits_t is the class_t->data field (class_rw_t pointer plus flags)
 // The extra bits are optimized for the retain/release and alloc/dealloc paths.
 
@@ -240,6 +243,23 @@ private:
 public:
     inline SEL sel() const { return _sel.load(memory_order::memory_order_relaxed); }
 
+    // Evicted buckets keep a selector that matches no real SEL, so 
+    // objc_msgSend treats them as a mismatch and probe sequences that 
+    // pass through them stay intact. They are never reused; they go 
+    // away when the cache is reallocated or erased.
+    static const uint8_t evictedSelStorage;
+    static SEL evictedSel() { return (SEL)&evictedSelStorage; }
+
+    // True if this bucket holds a usable SEL/IMP pair.
+    inline bool isLive() const {
+        SEL s = sel();
+        return s  &&  s != evictedSel()  &&  s != (SEL)(uintptr_t)1;
+    }
+
+    inline void evict() {
+        _sel.store(evictedSel(), memory_order::memory_order_release);
+    }
+
     inline IMP rawImp(objc_class *cls) const {
         uintptr_t imp = _imp.load(memory_order::memory_order_relaxed);
         if (!imp) return nil;
@@ -401,7 +421,11 @@ public:
     static size_t bytesForCapacity(uint32_t cap);
     static struct bucket_t * endMarker(struct bucket_t *b, uint32_t cap);
 
-    void reallocate(mask_t oldCapacity, mask_t newCapacity, bool freeOld);
+    mask_t copyBuckets(Class cls,
+                       struct bucket_t *oldBuckets, mask_t oldCapacity,
+                       struct bucket_t *newBuckets, mask_t newCapacity);
+    void reallocate(Class cls, mask_t oldCapacity, mask_t newCapacity,
+                    bool freeOld, bool copyOld);
     void insert(Class cls, SEL sel, IMP imp, id receiver);
 
     static void bad_cache(id receiver, SEL sel, Class isa) __attribute__((noreturn, cold));
@@ -1016,6 +1040,8 @@ class list_array_tt {
     }
 
     void setArray(array_t *array) {
+        // Publish the array's contents before the array itself.
+        __c11_atomic_thread_fence(__ATOMIC_RELEASE);
         arrayAndFlag = (uintptr_t)array | 1;
     }
 
@@ -1100,7 +1126,6 @@ class list_array_tt {
             //扩容生成新的数组
             array_t *newArray = (array_t *)malloc(array_t::byteSize(newCount));
             newArray->count = newCount; //更新长度
-            array()->count = newCount;
 
             //添加原有的(添加的位置是在后面 i + addedCount)
             for (int i = oldCount - 1; i >= 0; i--)
@@ -1108,8 +1133,10 @@ class list_array_tt {
             //添加新添加的
             for (unsigned i = 0; i < addedCount; i++)
                 newArray->lists[i] = addedLists[i];
-            free(array());
+            // Lock-free method lookup may still be reading the old array.
+            array_t *oldArray = array();
             setArray(newArray);
+            cache_epoch_retire(oldArray, oldArray->byteSize());
             validate();
         }
         else if (!list  &&  addedCount == 1) {
@@ -1123,12 +1150,13 @@ class list_array_tt {
             Ptr<List> oldList = list;
             uint32_t oldCount = oldList ? 1 : 0;
             uint32_t newCount = oldCount + addedCount;
-            setArray((array_t *)malloc(array_t::byteSize(newCount)));
-            array()->count = newCount;
+            array_t *newArray = (array_t *)malloc(array_t::byteSize(newCount));
+            newArray->count = newCount;
             //添加到最后一个
-            if (oldList) array()->lists[addedCount] = oldList;
+            if (oldList) newArray->lists[addedCount] = oldList;
             for (unsigned i = 0; i < addedCount; i++)
-                array()->lists[i] = addedLists[i];
+                newArray->lists[i] = addedLists[i];
+            setArray(newArray);
             validate();
         }
     }
@@ -1202,6 +1230,8 @@ class protocol_array_t :
     protocol_array_t(protocol_list_t *l) : Super(l) { }
 };
 #pragma mark - rw wwdc2020优化/可能没有,减少内存
+struct method_index_t;
+
 struct class_rw_ext_t {
     DECLARE_AUTHED_PTR_TEMPLATE(class_ro_t)
     class_ro_t_authed_ptr<const class_ro_t> ro;
@@ -1210,6 +1240,9 @@ struct class_rw_ext_t {
     protocol_array_t protocols;
     char *demangledName;
     uint32_t version;
+    // Lazily-built SEL -> method index over `methods`.
+    // Discarded whenever `methods` changes.
+    struct method_index_t *methodIndex;
 };
 
 #pragma mark - rw
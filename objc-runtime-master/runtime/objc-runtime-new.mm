@@ -46,6 +46,9 @@ static void free_class(Class cls);
 static IMP addMethod(Class cls, SEL name, IMP imp, const char *types, bool replace);
 static void adjustCustomFlagsForMethodChange(Class cls, method_t *meth);
 static method_t *search_method_list(const method_list_t *mlist, SEL sel);
+static void invalidateMethodIndex(class_rw_ext_t *rwe);
+static void forgetResolverMisses(Class cls);
+static void forgetConformances(void);
 template<typename T> static bool method_lists_contains_any(T *mlists, T *end,
         SEL sels[], size_t selcount);
 static void flushCaches(Class cls);
@@ -551,6 +554,37 @@ checkIsKnownClass(Class cls)
     }
 }
 
+/***********************************************************************
+* lookupSequence / LookupMutation
+* Sequence lock checked by lookUpImpLockFree(). The sequence is odd 
+* while a mutation is in progress and moves on after each one.
+* Locking: runtimeLock must be held by the mutator.
+**********************************************************************/
+explicit_atomic<uintptr_t> objc::lookupSequence{0};
+static unsigned lookupMutationDepth;
+
+objc::LookupMutation::LookupMutation()
+{
+    runtimeLock.assertLocked();
+
+    if (lookupMutationDepth++ == 0) {
+        lookupSequence.store(lookupSequence.load(std::memory_order_relaxed) + 1,
+                             std::memory_order_relaxed);
+        // Order the odd sequence before the mutation's own stores.
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+}
+
+objc::LookupMutation::~LookupMutation()
+{
+    runtimeLock.assertLocked();
+
+    if (--lookupMutationDepth == 0) {
+        lookupSequence.store(lookupSequence.load(std::memory_order_relaxed) + 1,
+                             std::memory_order_release);
+    }
+}
+
 /***********************************************************************
 * classNSObject
 * Returns class NSObject.
@@ -1353,6 +1387,8 @@ static void
 attachCategories(Class cls, const locstamped_category_t *cats_list, uint32_t cats_count,
                  int flags)
 {
+    objc::LookupMutation mutation;
+
     if (slowpath(PrintReplacedMethods)) {
         printReplacements(cls, cats_list, cats_count);
     }
@@ -1394,6 +1430,7 @@ attachCategories(Class cls, const locstamped_category_t *cats_list, uint32_t cat
             if (mcount == ATTACH_BUFSIZ) {
                 prepareMethodLists(cls, mlists, mcount, NO, fromBundle);
                 rwe->methods.attachLists(mlists, mcount);
+                invalidateMethodIndex(rwe);
                 mcount = 0;
             }
             mlists[ATTACH_BUFSIZ - ++mcount] = mlist;
@@ -1424,12 +1461,14 @@ attachCategories(Class cls, const locstamped_category_t *cats_list, uint32_t cat
     if (mcount > 0) {
         prepareMethodLists(cls, mlists + ATTACH_BUFSIZ - mcount, mcount, NO, fromBundle);
         rwe->methods.attachLists(mlists + ATTACH_BUFSIZ - mcount, mcount);
+        invalidateMethodIndex(rwe);
         if (flags & ATTACH_EXISTING) flushCaches(cls);
     }
 
     rwe->properties.attachLists(proplists + ATTACH_BUFSIZ - propcount, propcount);
 
     rwe->protocols.attachLists(protolists + ATTACH_BUFSIZ - protocount, protocount);
+    if (protocount > 0) forgetConformances();
 }
 
 
@@ -1461,7 +1500,10 @@ static void methodizeClass(Class cls, Class previously)
             _objc_fatal("CLASS: class '%s' %p small method list %p is not in immutable memory",
                         cls->nameForLogging(), cls, list);
         prepareMethodLists(cls, &list, 1, YES, isBundleClass(cls));
-        if (rwe) rwe->methods.attachLists(&list, 1);
+        if (rwe) {
+            rwe->methods.attachLists(&list, 1);
+            invalidateMethodIndex(rwe);
+        }
     }
 
     property_list_t *proplist = ro->baseProperties;
@@ -1735,6 +1777,319 @@ static Class getClassExceptSomeSwift(const char *name)
 }
 
 
+/***********************************************************************
+* namedClassTable
+* Lock-free index of the realized classes in gdb_objc_realized_classes, 
+* used by look_up_class() without runtimeLock.
+*
+* Open addressing over groups of 8 slots. Each slot has a tag byte: 
+* empty, deleted, or 0x80 plus 7 bits of the name's hash. A probe 
+* compares all 8 tags of a group at once in one 64-bit word and only 
+* checks the stored full hash and the name for slots whose tag matches. 
+* A group with an empty slot ends the probe.
+*
+* gdb_objc_realized_classes stays the table of record, for debuggers. 
+* A class is entered here when realizeClassWithoutSwift() finishes 
+* it, or when addNamedClass() names a class that is already realized 
+* and not RW_CONSTRUCTING - a duplicated class, or one built by 
+* objc_allocateClassPair() once objc_registerClassPair() completes it. 
+* Either way it must be what that table maps its name to, so a hit 
+* here is exactly what the locked lookup would have returned.
+*
+* Writers hold runtimeLock. A slot is written once, before its tag is 
+* published, and never rewritten: removal only marks the tag deleted, 
+* and deleted slots are reclaimed by rebuilding into a new table. 
+* The table keeps its own copy of each mutable name, since a disposed 
+* class frees its name while readers may still be comparing it. 
+* Readers run inside a cache epoch so a replaced table or a removed 
+* name is freed only after they leave it.
+**********************************************************************/
+namespace objc {
+
+struct NamedClassTable {
+    enum : uint8_t { Empty = 0, Deleted = 1, Full = 0x80 };
+    static constexpr uint64_t Ones = 0x0101010101010101ULL;
+    static constexpr uint64_t Highs = 0x8080808080808080ULL;
+
+    struct slot_t {
+        uint32_t hash;
+        const char *name;
+        Class cls;
+    };
+
+    struct group_t {
+        explicit_atomic<uint64_t> tags;
+        slot_t slots[8];
+    };
+
+    uint32_t mask;      // group count - 1
+    uint32_t count;     // full slots
+    uint32_t used;      // full and deleted slots
+    group_t groups[0];
+
+    static uint32_t hash(const char *name) {
+        // FNV-1a, so the tag bits are as good as the index bits
+        uint32_t h = 2166136261u;
+        while (uint8_t c = (uint8_t)*name++) {
+            h ^= c;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    static uint8_t tag(uint32_t hash) {
+        return Full | (hash >> 25);
+    }
+
+    // A high bit set in each byte of word that is zero. Exact for the 
+    // lowest zero byte; bytes above it may be false positives, which 
+    // the callers' hash and name checks reject.
+    static uint64_t zeroBytes(uint64_t word) {
+        return (word - Ones) & ~word & Highs;
+    }
+
+    uint32_t capacity() const { return (mask + 1) * 8; }
+
+    static size_t bytes(uint32_t groupCount) {
+        return sizeof(NamedClassTable) + groupCount * sizeof(group_t);
+    }
+
+    static NamedClassTable *create(uint32_t groupCount) {
+        auto table = (NamedClassTable *)calloc(1, bytes(groupCount));
+        table->mask = groupCount - 1;
+        return table;
+    }
+
+    // Locking: none
+    Class find(const char *name, uint32_t h) const {
+        uint64_t pattern = Ones * tag(h);
+        uint32_t g = h & mask;
+        for (uint32_t step = 1; step <= mask + 1; step++) {
+            const group_t& group = groups[g];
+            uint64_t tags = group.tags.load(std::memory_order_acquire);
+            for (uint64_t matches = zeroBytes(tags ^ pattern); 
+                 matches; 
+                 matches &= matches - 1) 
+            {
+                const slot_t& slot = group.slots[__builtin_ctzll(matches) / 8];
+                if (slot.hash == h  &&  0 == strcmp(slot.name, name)) {
+                    return slot.cls;
+                }
+            }
+            if (zeroBytes(tags)) return nil;
+            g = (g + step) & mask;
+        }
+        return nil;
+    }
+
+    // Locking: runtimeLock must be held by the caller.
+    bool erase(const char *name, uint32_t h) {
+        uint64_t pattern = Ones * tag(h);
+        uint32_t g = h & mask;
+        for (uint32_t step = 1; step <= mask + 1; step++) {
+            group_t& group = groups[g];
+            uint64_t tags = group.tags.load(std::memory_order_relaxed);
+            for (uint64_t matches = zeroBytes(tags ^ pattern); 
+                 matches; 
+                 matches &= matches - 1) 
+            {
+                unsigned i = __builtin_ctzll(matches) / 8;
+                const slot_t& slot = group.slots[i];
+                if (slot.hash == h  &&  0 == strcmp(slot.name, name)) {
+                    uint64_t byte = (uint64_t)0xff << (i * 8);
+                    tags = (tags & ~byte) | ((uint64_t)Deleted << (i * 8));
+                    group.tags.store(tags, std::memory_order_release);
+                    count--;
+                    size_t size = strlen(slot.name) + 1;
+                    if (!_dyld_is_memory_immutable(slot.name, size)) {
+                        cache_epoch_retire((void *)slot.name, size);
+                    }
+                    return true;
+                }
+            }
+            if (zeroBytes(tags)) return false;
+            g = (g + step) & mask;
+        }
+        return false;
+    }
+
+    // The name must not be present. The caller guarantees an empty slot.
+    // Locking: runtimeLock must be held by the caller.
+    void insert(const char *name, uint32_t h, Class cls) {
+        uint32_t g = h & mask;
+        for (uint32_t step = 1; ; step++) {
+            group_t& group = groups[g];
+            uint64_t tags = group.tags.load(std::memory_order_relaxed);
+            if (uint64_t empties = zeroBytes(tags)) {
+                unsigned i = __builtin_ctzll(empties) / 8;
+                group.slots[i] = { h, name, cls };
+                tags |= (uint64_t)tag(h) << (i * 8);
+                group.tags.store(tags, std::memory_order_release);
+                count++;
+                used++;
+                return;
+            }
+            g = (g + step) & mask;
+        }
+    }
+};
+
+static explicit_atomic<NamedClassTable *> namedClassTable{nil};
+
+
+// Locking: runtimeLock must be held by the caller.
+static void namedClassTableRemove(const char *name)
+{
+    runtimeLock.assertLocked();
+
+    auto table = namedClassTable.load(std::memory_order_relaxed);
+    if (table) table->erase(name, NamedClassTable::hash(name));
+}
+
+
+// Enter cls under name if it is complete and is what 
+// gdb_objc_realized_classes maps name to.
+// Locking: runtimeLock must be held by the caller.
+static void namedClassTablePublish(Class cls, const char *name)
+{
+    runtimeLock.assertLocked();
+
+    if (!cls->isRealized()  ||  (cls->data()->flags & RW_CONSTRUCTING)) return;
+    if (NXMapGet(gdb_objc_realized_classes, name) != cls) return;
+
+    uint32_t h = NamedClassTable::hash(name);
+    auto table = namedClassTable.load(std::memory_order_relaxed);
+    if (table  &&  table->find(name, h)) return;
+
+    // Keep at most 7/8 of the slots full or deleted.
+    if (!table  ||  (table->used + 1) * 8 > table->capacity() * 7) {
+        uint32_t groupCount = 8;
+        uint32_t live = table ? table->count + 1 : 1;
+        while (live * 2 > groupCount * 8) groupCount *= 2;
+
+        auto newTable = NamedClassTable::create(groupCount);
+        if (table) {
+            for (uint32_t g = 0; g <= table->mask; g++) {
+                auto& group = table->groups[g];
+                uint64_t tags = group.tags.load(std::memory_order_relaxed);
+                for (unsigned i = 0; i < 8; i++) {
+                    if ((tags >> (i * 8)) & NamedClassTable::Full) {
+                        auto& slot = group.slots[i];
+                        newTable->insert(slot.name, slot.hash, slot.cls);
+                    }
+                }
+            }
+        }
+        namedClassTable.store(newTable, std::memory_order_release);
+        if (table) {
+            cache_epoch_retire(table, NamedClassTable::bytes(table->mask + 1));
+        }
+        table = newTable;
+    }
+
+    table->insert(strdupIfMutable(name), h, cls);
+}
+
+
+// Returns the realized class named name, or nil if the 
+// locked lookup must decide.
+// Locking: none
+static Class namedClassTableFind(const char *name)
+{
+    cache_epoch_enter();
+    auto table = namedClassTable.load(std::memory_order_acquire);
+    Class result = table ? table->find(name, NamedClassTable::hash(name)) : nil;
+    cache_epoch_exit();
+    return result;
+}
+
+
+/***********************************************************************
+* missingClassNames
+* Bounded cache of names that look_up_class() found no class for, 
+* not even through the getClass hooks.
+*
+* Each entry records the generation it was looked up in. Anything 
+* that could make a missing name resolve - a new named class, a newly 
+* mapped image, a newly installed hook - bumps the generation, which 
+* invalidates every entry at once. An entry is dropped if the 
+* generation moved while its lookup was in progress.
+*
+* Entries are immutable. Writers hold runtimeLock and replace a slot 
+* whole, retiring the old entry through a cache epoch. 
+* Readers take no lock.
+**********************************************************************/
+struct MissingClassName {
+    uintptr_t generation;
+    uint32_t hash;
+    char name[0];
+};
+
+#define MISSING_CLASS_NAME_COUNT 256
+
+static std::atomic<MissingClassName *> missingClassNames[MISSING_CLASS_NAME_COUNT];
+static std::atomic<uintptr_t> missingClassGeneration{0};
+
+
+// Locking: none
+static uintptr_t missingClassNamesGeneration()
+{
+    return missingClassGeneration.load(std::memory_order_acquire);
+}
+
+
+// Forget every missing name.
+// Locking: none
+static void invalidateMissingClassNames()
+{
+    missingClassGeneration.fetch_add(1, std::memory_order_acq_rel);
+}
+
+
+// Returns true if name was missing as of generation.
+// Locking: none
+static bool isMissingClassName(const char *name, uintptr_t generation)
+{
+    uint32_t h = NamedClassTable::hash(name);
+    auto& slot = missingClassNames[h % MISSING_CLASS_NAME_COUNT];
+
+    cache_epoch_enter();
+    auto entry = slot.load(std::memory_order_acquire);
+    bool result = entry  &&  entry->generation == generation  &&  
+        entry->hash == h  &&  0 == strcmp(entry->name, name);
+    cache_epoch_exit();
+    return result;
+}
+
+
+// Record that name was missing as of generation.
+// Locking: acquires runtimeLock
+static void addMissingClassName(const char *name, uintptr_t generation)
+{
+    uint32_t h = NamedClassTable::hash(name);
+    auto& slot = missingClassNames[h % MISSING_CLASS_NAME_COUNT];
+
+    mutex_locker_t lock(runtimeLock);
+    if (generation != missingClassNamesGeneration()) return;
+
+    size_t length = strlen(name) + 1;
+    auto entry = (MissingClassName *)malloc(sizeof(MissingClassName) + length);
+    entry->generation = generation;
+    entry->hash = h;
+    memcpy(entry->name, name, length);
+
+    auto old = slot.exchange(entry, std::memory_order_acq_rel);
+    if (old) {
+        cache_epoch_retire(old, sizeof(*old) + strlen(old->name) + 1);
+        // Colliding names replace each other on every miss.
+        // Don't let the garbage wait for a method cache to be freed.
+        cache_epoch_try_advance();
+    }
+}
+
+}
+
+
 /***********************************************************************
 * addNamedClass
 * Adds name => cls to the named non-meta class map.
@@ -1753,7 +2108,10 @@ static void addNamedClass(Class cls, const char *name, Class replacing = nil)
         // secondary meta->nonmeta table.
         addNonMetaClass(cls);
     } else {
+        objc::namedClassTableRemove(name);
         NXMapInsert(gdb_objc_realized_classes, name, cls);
+        objc::namedClassTablePublish(cls, name);
+        objc::invalidateMissingClassNames();
     }
     ASSERT(!(cls->data()->flags & RO_META));
 
@@ -1773,6 +2131,7 @@ static void removeNamedClass(Class cls, const char *name)
     ASSERT(!(cls->data()->flags & RO_META));
     if (cls == NXMapGet(gdb_objc_realized_classes, name)) {
         NXMapRemove(gdb_objc_realized_classes, name);
+        objc::namedClassTableRemove(name);
     } else {
         // cls has a name collision with another class - don't remove the other
         // but do remove cls from the secondary metaclass->class map.
@@ -2683,6 +3042,8 @@ static Class realizeClassWithoutSwift(Class cls, Class previously)
     // Attach categories
     methodizeClass(cls, previously);
 
+    if (!isMeta) objc::namedClassTablePublish(cls, cls->mangledName());
+
     return cls;
 }
 
@@ -3016,6 +3377,35 @@ static void flushCaches(Class cls)
 }
 
 
+/***********************************************************************
+* flushCachesForMethodChange
+* The IMP of a method named sel changed from oldImp. Evict sel from 
+* the caches that dispatch it to oldImp and leave everything else 
+* cached. cls is the class that owns the method, or nil if unknown, in 
+* which case every realized class and metaclass is checked.
+* Locking: runtimeLock must be held by the caller
+**********************************************************************/
+static void flushCachesForMethodChange(Class cls, SEL sel, IMP oldImp)
+{
+    runtimeLock.assertLocked();
+#if CONFIG_USE_CACHE_LOCK
+    mutex_locker_t lock(cacheUpdateLock);
+#endif
+
+    auto evict = ^(Class c){
+        cache_evict_nolock(c, sel, oldImp);
+        return true;
+    };
+
+    if (cls) {
+        foreach_realized_class_and_subclass(cls, evict);
+    }
+    else {
+        foreach_realized_class_and_metaclass(evict);
+    }
+}
+
+
 void _objc_flush_caches(Class cls)
 {
     {
@@ -3813,6 +4203,10 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
                      "pre-optimized", UnfixedProtocolReferences);
     }
 
+    // Classes in these images, including preoptimized classes 
+    // that were never added by name, may answer missing names now.
+    objc::invalidateMissingClassNames();
+
 #undef EACH_HEADER
 }
 
@@ -3943,6 +4337,10 @@ void _unload_image(header_info *hi)
     // XXX FIXME -- Clean up protocols:
     // <rdar://problem/9033191> Support unloading protocols at dylib/image unload time
 
+    // The image's protocols go away with it, and their addresses 
+    // may be reused.
+    forgetConformances();
+
     // fixme DebugUnload
 }
 
@@ -4016,6 +4414,8 @@ _method_setImplementation(Class cls, method_t *m, IMP imp)
     if (!m) return nil;
     if (!imp) return nil;
 
+    objc::LookupMutation mutation;
+
     IMP old = m->imp(false);
     m->setImp(imp);
 
@@ -4023,7 +4423,7 @@ _method_setImplementation(Class cls, method_t *m, IMP imp)
     // RR/AWZ updates are slow if cls is nil (i.e. unknown)
     // fixme build list of classes whose Methods are known externally?
 
-    flushCaches(cls);
+    if (old != imp) flushCachesForMethodChange(cls, m->name(), old);
 
     adjustCustomFlagsForMethodChange(cls, m);
 
@@ -4045,9 +4445,11 @@ void method_exchangeImplementations(Method m1, Method m2)
     if (!m1  ||  !m2) return;
 
     mutex_locker_t lock(runtimeLock);
+    objc::LookupMutation mutation;
 
     IMP m1_imp = m1->imp(false);
-    m1->setImp(m2->imp(false));
+    IMP m2_imp = m2->imp(false);
+    m1->setImp(m2_imp);
     m2->setImp(m1_imp);
 
 
@@ -4055,7 +4457,10 @@ void method_exchangeImplementations(Method m1, Method m2)
     // Cache updates are slow because class is unknown
     // fixme build list of classes whose Methods are known externally?
 
-    flushCaches(nil);
+    if (m1_imp != m2_imp) {
+        flushCachesForMethodChange(nil, m1->name(), m1_imp);
+        flushCachesForMethodChange(nil, m2->name(), m2_imp);
+    }
 
     adjustCustomFlagsForMethodChange(nil, m1);
     adjustCustomFlagsForMethodChange(nil, m2);
@@ -4793,6 +5198,8 @@ void objc_registerProtocol(Protocol *proto_gen)
     if (getProtocol(proto->mangledName) == nil) {
         NXMapKeyCopyingInsert(protocols(), proto->mangledName, proto);
     }
+
+    forgetConformances();
 }
 
 
@@ -4841,6 +5248,7 @@ protocol_addProtocol(Protocol *proto_gen, Protocol *addition_gen)
 
     protolist->list[protolist->count++] = (protocol_ref_t)addition;
     proto->protocols = protolist;
+    forgetConformances();
 }
 
 
@@ -5018,7 +5426,7 @@ class_getImpCache_nolock(Class cls, cache_t &cache, objc_imp_cache_entry *buffer
     int wpos = 0;
 
     for (index = 0; index < count && wpos < len; index += 1) {
-        if (buckets[index].sel()) {
+        if (buckets[index].isLive()) {
             buffer[wpos].imp = buckets[index].imp(cls);
             buffer[wpos].sel = buckets[index].sel();
             wpos++;
@@ -5113,6 +5521,204 @@ class_copyImpCache(Class cls, int *outCount)
 }
 
 
+/***********************************************************************
+ * Method cache profiles
+ * objc_cache_writeProfile() records the contents of every realized 
+ * class's method cache. objc_cache_loadProfile() reads such a profile 
+ * back and fills the listed caches, either immediately if the class is 
+ * already +initialized or as soon as its +initialize completes.
+ *
+ * Only class names and selector names are recorded. IMPs are looked up 
+ * afresh through lookUpImpOrForward(), so a stale profile can only cost 
+ * wasted lookups, never a wrong dispatch. Selectors that no longer 
+ * exist are not cached as forwarded, so resolvers still run for them.
+ *
+ * The profile is a text file with one line per cache: '-' (instance 
+ * methods) or '+' (class methods), the class name, then the selectors, 
+ * all separated by spaces.
+ **********************************************************************/
+struct cache_profile_t {
+    SEL *sels;
+    uint32_t count;
+};
+
+// Pending profile entries, keyed by class or metaclass.
+// Protected by runtimeLock.
+static objc::LazyInitDenseMap<Class, cache_profile_t> cacheProfiles;
+static bool haveCacheProfiles;
+
+static void
+preloadCacheFromProfile(Class cls, cache_profile_t profile)
+{
+    runtimeLock.assertUnlocked();
+
+    for (uint32_t i = 0; i < profile.count; i++) {
+        lookUpImpOrForward(nil, profile.sels[i], cls,
+                           LOOKUP_CACHE | LOOKUP_NIL | LOOKUP_NOFORWARD);
+    }
+    free(profile.sels);
+}
+
+/***********************************************************************
+ * preloadCachesFromProfile
+ * Fill cls's and its metaclass's caches from any pending profile.
+ * Called when cls is marked initialized, including when that was 
+ * deferred until its superclass finished +initialize.
+ * Locking: acquires runtimeLock. classInitLock may be held.
+ **********************************************************************/
+void
+preloadCachesFromProfile(Class cls)
+{
+    ASSERT(!cls->isMetaClass());
+    ASSERT(cls->isInitialized());
+
+    if (fastpath(!haveCacheProfiles)) return;
+
+    Class classes[2] = { cls, cls->ISA() };
+    cache_profile_t profiles[2] = {};
+    {
+        mutex_locker_t lock(runtimeLock);
+        auto map = cacheProfiles.get(false);
+        if (!map) return;
+        for (int i = 0; i < 2; i++) {
+            auto it = map->find(classes[i]);
+            if (it == map->end()) continue;
+            profiles[i] = it->second;
+            map->erase(it);
+        }
+        haveCacheProfiles = !map->empty();
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (profiles[i].count) preloadCacheFromProfile(classes[i], profiles[i]);
+    }
+}
+
+/***********************************************************************
+ * objc_cache_writeProfile
+ * Writes the selectors in every realized class's method cache to path.
+ * Returns false if the file could not be written.
+ * Locking: acquires runtimeLock
+ **********************************************************************/
+bool
+objc_cache_writeProfile(const char *path)
+{
+    const IMP forward_imp = (IMP)_objc_msgForward_impcache;
+    char *buffer = nil;
+    size_t length = 0;
+
+    if (!path) return false;
+
+    FILE *stream = open_memstream(&buffer, &length);
+    if (!stream) return false;
+
+    // Format in memory with the lock held and do the I/O without it.
+    {
+        mutex_locker_t lock(runtimeLock);
+
+        foreach_realized_class_and_metaclass([=](Class cls) {
+            cache_t &cache = cls->cache;
+            if (cache.occupied() == 0) return true;
+
+            bucket_t *buckets = cache.buckets();
+            unsigned capacity = cache.capacity();
+            bool wroteClass = false;
+
+            for (unsigned index = 0; index < capacity; index++) {
+                if (!buckets[index].isLive()) continue;
+                if (buckets[index].imp(cls) == forward_imp) continue;
+                SEL sel = buckets[index].sel();
+
+                if (!wroteClass) {
+                    fprintf(stream, "%c%s", cls->isMetaClass() ? '+' : '-',
+                            cls->mangledName());
+                    wroteClass = true;
+                }
+                fprintf(stream, " %s", sel_getName(sel));
+            }
+            if (wroteClass) fputc('\n', stream);
+            return true;
+        });
+    }
+
+    fclose(stream);
+
+    bool ok = false;
+    FILE *file = fopen(path, "w");
+    if (file) {
+        ok = fwrite(buffer, 1, length, file) == length;
+        ok = (fclose(file) == 0)  &&  ok;
+    }
+    free(buffer);
+    return ok;
+}
+
+/***********************************************************************
+ * objc_cache_loadProfile
+ * Reads a profile written by objc_cache_writeProfile() and fills the 
+ * listed method caches. Classes that are not yet +initialized are 
+ * filled right after their +initialize completes.
+ * Returns the number of cache entries scheduled, or 0 on error.
+ * Locking: acquires runtimeLock
+ **********************************************************************/
+unsigned int
+objc_cache_loadProfile(const char *path)
+{
+    unsigned int total = 0;
+    char *line = nil;
+    size_t lineCapacity = 0;
+
+    if (!path) return 0;
+
+    FILE *file = fopen(path, "r");
+    if (!file) return 0;
+
+    while (getline(&line, &lineCapacity, file) > 0) {
+        char *last;
+        char *word = strtok_r(line, " \n", &last);
+        if (!word  ||  (word[0] != '-'  &&  word[0] != '+')) continue;
+
+        Class nonmeta = objc_lookUpClass(word + 1);
+        if (!nonmeta) continue;
+        Class cls = (word[0] == '+') ? nonmeta->ISA() : nonmeta;
+
+        cache_profile_t profile = {};
+        uint32_t capacity = 0;
+        while ((word = strtok_r(nil, " \n", &last))) {
+            if (profile.count == capacity) {
+                capacity = capacity ? capacity * 2 : 16;
+                profile.sels = (SEL *)
+                    realloc(profile.sels, capacity * sizeof(SEL));
+            }
+            profile.sels[profile.count++] = sel_registerName(word);
+        }
+        if (!profile.count) {
+            free(profile.sels);
+            continue;
+        }
+        total += profile.count;
+
+        {
+            mutex_locker_t lock(runtimeLock);
+            auto result = cacheProfiles.get(true)->try_emplace(cls, profile);
+            if (!result.second) {
+                // Duplicate line for this class. Keep the first one.
+                free(profile.sels);
+            }
+            haveCacheProfiles = true;
+        }
+
+        // Handle classes that finished +initialize before or while 
+        // their profile was added.
+        if (nonmeta->isInitialized()) preloadCachesFromProfile(nonmeta);
+    }
+
+    free(line);
+    fclose(file);
+    return total;
+}
+
+
 /***********************************************************************
 * objc_copyProtocolList
 * Returns pointers to all protocols.
@@ -5824,6 +6430,107 @@ class_setVersion(Class cls, int version)
     rwe->version = version;
 }
 
+/***********************************************************************
+ * method_index_t
+ * An open-addressed SEL -> method_t table covering every list in a 
+ * class's method_array_t. Each selector maps to its first match in 
+ * list order, which is what a search of the lists one by one finds, 
+ * so category overrides are preserved.
+ *
+ * getMethodNoSuper_nolock() builds one on demand for classes with at 
+ * least METHOD_INDEX_MIN_LISTS method lists, turning each slow-path 
+ * lookup from one binary search per list into a single hash probe. 
+ * Every change to the lists discards the index via 
+ * invalidateMethodIndex().
+ * Locking: runtimeLock must be held to build or discard an index. 
+ * lookUpImpLockFree() probes existing indexes without it.
+ **********************************************************************/
+enum {
+    METHOD_INDEX_MIN_LISTS = 8,
+};
+
+struct method_index_t {
+    struct entry {
+        SEL sel;
+        method_t *meth;
+    };
+
+    // mask + 1 entries follow the header.
+    uintptr_t mask;
+
+    entry *entries() {
+        return (entry *)(this + 1);
+    }
+    const entry *entries() const {
+        return (const entry *)(this + 1);
+    }
+
+    static size_t bytes(uint32_t capacity) {
+        return sizeof(method_index_t) + capacity * sizeof(entry);
+    }
+
+    static uint32_t hash(SEL sel) {
+        uint64_t value = (uintptr_t)sel;
+        return (uint32_t)((value * 0x9e3779b97f4a7c15ULL) >> 32);
+    }
+
+    method_t *find(SEL sel) const {
+        const entry *e = entries();
+        for (uintptr_t i = hash(sel) & mask; ; i = (i + 1) & mask) {
+            if (e[i].sel == sel) return e[i].meth;
+            if (e[i].sel == nil) return nil;
+        }
+    }
+
+    // Adds sel unless it is already present.
+    void insert(SEL sel, method_t *meth) {
+        entry *e = entries();
+        for (uintptr_t i = hash(sel) & mask; ; i = (i + 1) & mask) {
+            if (e[i].sel == sel) return;
+            if (e[i].sel == nil) {
+                e[i].sel = sel;
+                e[i].meth = meth;
+                return;
+            }
+        }
+    }
+
+    static method_index_t *create(const method_array_t& methods) {
+        // Keep the load factor at or below 1/2 so probes stay short 
+        // and find() always reaches an empty slot.
+        uint32_t capacity = 16;
+        uint32_t count = methods.count();
+        while (capacity < count * 2) capacity *= 2;
+
+        auto index = (method_index_t *)calloc(bytes(capacity), 1);
+        index->mask = capacity - 1;
+
+        for (auto mlists = methods.beginLists(), end = methods.endLists();
+             mlists != end;
+             ++mlists)
+        {
+            for (auto& meth : **mlists) {
+                index->insert(meth.name(), &meth);
+            }
+        }
+        return index;
+    }
+};
+
+static void
+invalidateMethodIndex(class_rw_ext_t *rwe)
+{
+    runtimeLock.assertLocked();
+
+    if (rwe->methodIndex) {
+        // Lock-free method lookup may still be probing the index.
+        auto index = rwe->methodIndex;
+        rwe->methodIndex = nil;
+        cache_epoch_retire(index, method_index_t::bytes(index->mask + 1));
+    }
+}
+
+
 /***********************************************************************
  * search_method_list_inline
  **********************************************************************/
@@ -5944,6 +6651,20 @@ getMethodNoSuper_nolock(Class cls, SEL sel)
     // fixme nil cls? 
     // fixme nil sel?
 
+    // Heavily categorized classes use a hashed index of all their lists.
+    auto rwe = cls->data()->ext();
+    if (slowpath(rwe  &&  
+                 rwe->methods.countLists() >= METHOD_INDEX_MIN_LISTS))
+    {
+        if (!rwe->methodIndex) {
+            auto index = method_index_t::create(rwe->methods);
+            // Publish the entries before lock-free lookup can see them.
+            std::atomic_thread_fence(std::memory_order_release);
+            rwe->methodIndex = index;
+        }
+        return rwe->methodIndex->find(sel);
+    }
+
     auto const methods = cls->data()->methods();
     for (auto mlists = methods.beginLists(),
               end = methods.endLists();
@@ -5962,6 +6683,36 @@ getMethodNoSuper_nolock(Class cls, SEL sel)
 }
 
 
+/***********************************************************************
+ * getMethodNoSuper_lockfree
+ * Like getMethodNoSuper_nolock, but for lookUpImpLockFree(). Uses an 
+ * existing method index but never builds one.
+ * Locking: none. The caller must be inside a cache epoch and must 
+ * validate the result against objc::lookupSequence.
+ **********************************************************************/
+static method_t *
+getMethodNoSuper_lockfree(Class cls, SEL sel)
+{
+    auto rwe = cls->data()->ext();
+    if (rwe) {
+        auto index = rwe->methodIndex;
+        if (index) return index->find(sel);
+    }
+
+    auto const methods = cls->data()->methods();
+    for (auto mlists = methods.beginLists(),
+              end = methods.endLists();
+         mlists != end;
+         ++mlists)
+    {
+        method_t *m = search_method_list_inline(*mlists, sel);
+        if (m) return m;
+    }
+
+    return nil;
+}
+
+
 /***********************************************************************
 * getMethod_nolock
 * fixme
@@ -6119,6 +6870,71 @@ static void resolveInstanceMethod(id inst, SEL sel, Class cls)
 }
 
 
+/***********************************************************************
+* Resolver misses
+* Selectors for which +resolveInstanceMethod: and +resolveClassMethod: 
+* produced no implementation, per class. lookUpImpOrForward() skips 
+* the resolvers for them and forwards straight away.
+*
+* Each class's set is stamped with objc::lookupSequence as it was 
+* before the resolvers ran. Any method list change since then, such as 
+* class_addMethod() or a category, makes the whole set stale.
+* OBJC_DISABLE_RESOLVER_CACHE turns this off for resolvers whose answer 
+* depends on state outside the runtime.
+* Locking: runtimeLock must be held.
+**********************************************************************/
+struct resolver_misses_t {
+    uintptr_t sequence;
+    objc::DenseSet<SEL> sels;
+};
+
+static objc::LazyInitDenseMap<Class, resolver_misses_t> resolverMisses;
+
+static bool resolverDeclined(Class cls, SEL sel)
+{
+    runtimeLock.assertLocked();
+
+    auto map = resolverMisses.get(false);
+    if (!map) return false;
+
+    auto it = map->find(cls);
+    if (it == map->end()) return false;
+    if (it->second.sequence != 
+        objc::lookupSequence.load(std::memory_order_relaxed))
+    {
+        map->erase(it);
+        return false;
+    }
+    return it->second.sels.count(sel);
+}
+
+static void rememberResolverMiss(Class cls, SEL sel, uintptr_t sequence)
+{
+    runtimeLock.assertLocked();
+
+    // Something changed while the resolvers ran.
+    if (sequence != objc::lookupSequence.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    auto& misses = (*resolverMisses.get(true))[cls];
+    if (misses.sequence != sequence) {
+        misses.sels.clear();
+        misses.sequence = sequence;
+    }
+    misses.sels.insert(sel);
+}
+
+static void forgetResolverMisses(Class cls)
+{
+    runtimeLock.assertLocked();
+
+    if (auto map = resolverMisses.get(false)) {
+        map->erase(cls);
+    }
+}
+
+
 /***********************************************************************
 * resolveMethod_locked
 * Call +resolveClassMethod or +resolveInstanceMethod.
@@ -6132,6 +6948,8 @@ resolveMethod_locked(id inst, SEL sel, Class cls, int behavior)
     runtimeLock.assertLocked();
     ASSERT(cls->isRealized());
 
+    uintptr_t sequence = objc::lookupSequence.load(std::memory_order_relaxed);
+
     runtimeLock.unlock();
 
     if (! cls->isMetaClass()) {
@@ -6147,6 +6965,11 @@ resolveMethod_locked(id inst, SEL sel, Class cls, int behavior)
         }
     }
 
+    if (!DisableResolverCache  &&  !lookUpImpOrNil(inst, sel, cls)) {
+        mutex_locker_t lock(runtimeLock);
+        rememberResolverMiss(cls, sel, sequence);
+    }
+
     // chances are that calling the resolver have populated the cache
     // so attempt using it
     return lookUpImpOrForward(inst, sel, cls, behavior | LOOKUP_CACHE);
@@ -6175,6 +6998,87 @@ log_and_fill_cache(Class cls, IMP imp, SEL sel, id receiver, Class implementer)
 }
 
 
+/***********************************************************************
+* lookUpImpLockFree.
+* Searches the method lists of a realized, initialized class and its 
+* superclasses without taking runtimeLock.
+*
+* The search runs inside a cache epoch, so method arrays and indexes 
+* retired by a concurrent writer stay allocated, and it is validated 
+* against objc::lookupSequence, so a search that overlapped a change 
+* to the lists is discarded. The result is cached only if runtimeLock 
+* can be taken without waiting and nothing has changed since.
+*
+* Returns nil if the search was abandoned or found no implementation. 
+* The caller then takes the locked path, which also handles unknown 
+* classes, resolvers, forwarding, and message logging.
+* Locking: runtimeLock must not be held.
+**********************************************************************/
+static IMP
+lookUpImpLockFree(id inst, SEL sel, Class cls)
+{
+    const IMP forward_imp = (IMP)_objc_msgForward_impcache;
+    IMP imp = nil;
+    Class curClass = cls;
+    uintptr_t seq;
+
+#if SUPPORT_MESSAGE_LOGGING
+    if (slowpath(objcMsgLogEnabled)) return nil;
+#endif
+
+    cache_epoch_enter();
+
+    seq = objc::lookupSequence.load(std::memory_order_acquire);
+    if (slowpath(seq & 1)) goto done;
+
+    // Only the witness fastpath of isKnownClass() is usable here. 
+    // Anything else goes through checkIsKnownClass() under the lock.
+    if (slowpath(!objc::dataSegmentsRanges.contains(cls->data()->witness,
+                                                     (uintptr_t)cls)))
+    {
+        goto done;
+    }
+    // Don't trust ranges that were read while they were being changed.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slowpath(objc::lookupSequence.load(std::memory_order_relaxed) != seq)) {
+        goto done;
+    }
+
+    // The locked path diagnoses superclass cycles.
+    for (unsigned attempts = 1 << 16; --attempts != 0; ) {
+        method_t *meth = getMethodNoSuper_lockfree(curClass, sel);
+        if (meth) {
+            imp = meth->imp(false);
+            break;
+        }
+
+        if (slowpath((curClass = curClass->superclass) == nil)) break;
+
+        imp = cache_getImp(curClass, sel);
+        if (imp) break;
+    }
+
+    if (imp == forward_imp) imp = nil;
+    if (imp) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (objc::lookupSequence.load(std::memory_order_relaxed) != seq) {
+            imp = nil;
+        }
+    }
+
+ done:
+    cache_epoch_exit();
+
+    if (imp  &&  runtimeLock.tryLock()) {
+        if (objc::lookupSequence.load(std::memory_order_relaxed) == seq) {
+            log_and_fill_cache(cls, imp, sel, inst, curClass);
+        }
+        runtimeLock.unlock();
+    }
+    return imp;
+}
+
+
 /***********************************************************************
 * lookUpImpOrForward.
 * The standard IMP lookup. 
@@ -6201,6 +7105,13 @@ IMP lookUpImpOrForward(id inst, SEL sel, Class cls, int behavior)
         if (imp) goto done_nolock;
     }
 
+    // Optimistic method list search, for classes that no longer need 
+    // realizing or initializing.
+    if (fastpath(cls->isRealized()  &&  cls->isInitialized())) {
+        imp = lookUpImpLockFree(inst, sel, cls);
+        if (imp) goto done_nolock;
+    }
+
     // runtimeLock is held during isRealized and isInitialized checking
     // to prevent races against concurrent realization.
 
@@ -6283,11 +7194,15 @@ IMP lookUpImpOrForward(id inst, SEL sel, Class cls, int behavior)
 
     if (slowpath(behavior & LOOKUP_RESOLVER)) {
         behavior ^= LOOKUP_RESOLVER;
-        return resolveMethod_locked(inst, sel, cls, behavior);
+        if (!resolverDeclined(cls, sel)) {
+            return resolveMethod_locked(inst, sel, cls, behavior);
+        }
     }
 
  done:
-    log_and_fill_cache(cls, imp, sel, inst, curClass);
+    if (fastpath(imp != forward_imp  ||  !(behavior & LOOKUP_NOFORWARD))) {
+        log_and_fill_cache(cls, imp, sel, inst, curClass);
+    }
     runtimeLock.unlock();
  done_nolock:
     if (slowpath((behavior & LOOKUP_NIL) && imp == forward_imp)) {
@@ -6645,10 +7560,90 @@ _class_getVariable(Class cls, const char *name)
 }
 
 
+/***********************************************************************
+* Conformances
+* Results of class_conformsToProtocol(), yes or no, keyed by class and 
+* protocol in a fixed number of direct-mapped slots.
+*
+* Each result is stamped with conformanceGeneration. Anything that can 
+* change an answer - a protocol added to a class or to a protocol, a 
+* category attached, a protocol registered, a class freed or an image 
+* unloaded so that its address can be reused - bumps the generation 
+* and makes every result stale at once.
+*
+* Results are immutable. Writers hold runtimeLock and replace a slot 
+* whole, retiring the old result through a cache epoch. 
+* Readers take no lock.
+**********************************************************************/
+struct conformance_t {
+    uintptr_t generation;
+    Class cls;
+    protocol_t *proto;
+    bool conforms;
+};
+
+#define CONFORMANCE_COUNT 1024
+
+static std::atomic<conformance_t *> conformances[CONFORMANCE_COUNT];
+static std::atomic<uintptr_t> conformanceGeneration{0};
+
+static std::atomic<conformance_t *>& 
+conformanceSlot(Class cls, protocol_t *proto)
+{
+    uint32_t h = ptr_hash((uintptr_t)cls) ^ ptr_hash((uintptr_t)proto);
+    return conformances[h % CONFORMANCE_COUNT];
+}
+
+// Returns true and sets *outConforms if the answer for cls and proto 
+// is known.
+// Locking: none
+static bool knownConformance(Class cls, protocol_t *proto, bool *outConforms)
+{
+    uintptr_t generation = 
+        conformanceGeneration.load(std::memory_order_acquire);
+    auto& slot = conformanceSlot(cls, proto);
+
+    cache_epoch_enter();
+    auto result = slot.load(std::memory_order_acquire);
+    bool known = result  &&  result->generation == generation  &&  
+        result->cls == cls  &&  result->proto == proto;
+    if (known) *outConforms = result->conforms;
+    cache_epoch_exit();
+    return known;
+}
+
+static void rememberConformance(Class cls, protocol_t *proto, bool conforms)
+{
+    runtimeLock.assertLocked();
+
+    auto result = (conformance_t *)malloc(sizeof(conformance_t));
+    result->generation = conformanceGeneration.load(std::memory_order_relaxed);
+    result->cls = cls;
+    result->proto = proto;
+    result->conforms = conforms;
+
+    auto& slot = conformanceSlot(cls, proto);
+    auto old = slot.exchange(result, std::memory_order_acq_rel);
+    if (old) {
+        cache_epoch_retire(old, sizeof(*old));
+        // Colliding pairs replace each other on every miss.
+        // Don't let the garbage wait for a method cache to be freed.
+        cache_epoch_try_advance();
+    }
+}
+
+static void forgetConformances(void)
+{
+    runtimeLock.assertLocked();
+
+    conformanceGeneration.fetch_add(1, std::memory_order_release);
+}
+
+
 /***********************************************************************
 * class_conformsToProtocol
 * fixme
-* Locking: read-locks runtimeLock
+* Locking: acquires runtimeLock unless the answer is already known
 **********************************************************************/
 BOOL class_conformsToProtocol(Class cls, Protocol *proto_gen)
 {
@@ -6657,20 +7652,26 @@ BOOL class_conformsToProtocol(Class cls, Protocol *proto_gen)
     if (!cls) return NO;
     if (!proto_gen) return NO;
 
+    bool conforms;
+    if (knownConformance(cls, proto, &conforms)) return conforms;
+
     mutex_locker_t lock(runtimeLock);
 
     checkIsKnownClass(cls);
     
     ASSERT(cls->isRealized());
     
+    conforms = NO;
     for (const auto& proto_ref : cls->data()->protocols()) {
         protocol_t *p = remapProtocol(proto_ref);
         if (p == proto || protocol_conformsToProtocol_nolock(p, proto)) {
-            return YES;
+            conforms = YES;
+            break;
         }
     }
 
-    return NO;
+    rememberConformance(cls, proto, conforms);
+    return conforms;
 }
 
 
@@ -6691,6 +7692,8 @@ addMethod(Class cls, SEL name, IMP imp, const char *types, bool replace)
     ASSERT(types);
     ASSERT(cls->isRealized());
 
+    objc::LookupMutation mutation;
+
     method_t *m;
     if ((m = getMethodNoSuper_nolock(cls, name))) {
         // already exists
@@ -6715,6 +7718,7 @@ addMethod(Class cls, SEL name, IMP imp, const char *types, bool replace)
 
         prepareMethodLists(cls, &newlist, 1, NO, NO);
         rwe->methods.attachLists(&newlist, 1);
+        invalidateMethodIndex(rwe);
         flushCaches(cls);
 
         result = nil;
@@ -6741,6 +7745,8 @@ addMethods(Class cls, const SEL *names, const IMP *imps, const char **types,
     ASSERT(imps);
     ASSERT(types);
     ASSERT(cls->isRealized());
+
+    objc::LookupMutation mutation;
     
     method_list_t *newlist;
     size_t newlistSize = method_list_t::byteSize(sizeof(struct method_t::big), count);
@@ -6789,6 +7795,7 @@ addMethods(Class cls, const SEL *names, const IMP *imps, const char **types,
         
         prepareMethodLists(cls, &newlist, 1, NO, NO);
         rwe->methods.attachLists(&newlist, 1);
+        invalidateMethodIndex(rwe);
         flushCaches(cls);
     } else {
         // Attaching the method list to the class consumes it. If we don't
@@ -6949,6 +7956,7 @@ BOOL class_addProtocol(Class cls, Protocol *protocol_gen)
     protolist->list[0] = (protocol_ref_t)protocol;
 
     rwe->protocols.attachLists(&protolist, 1);
+    forgetConformances();
 
     // fixme metaclass?
 
@@ -7032,6 +8040,7 @@ void objc_setHook_getClass(objc_hook_getClass newValue,
                            objc_hook_getClass *outOldValue)
 {
     GetClassHook.set(newValue, outOldValue);
+    objc::invalidateMissingClassNames();
 }
 
 Class 
@@ -7041,6 +8050,16 @@ look_up_class(const char *name,
 {
     if (!name) return nil;
 
+    // Read the generation before looking, so a class added 
+    // during the lookup keeps a miss from being cached.
+    uintptr_t generation = objc::missingClassNamesGeneration();
+
+    // Realized classes with this name need no lock.
+    if (Class cls = objc::namedClassTableFind(name)) return cls;
+
+    // Neither do names that recently matched nothing.
+    if (objc::isMissingClassName(name, generation)) return nil;
+
     Class result;
     bool unrealized;
     {
@@ -7094,6 +8113,12 @@ look_up_class(const char *name,
         ASSERT(slot >= 0  &&  slot < tls->classNameLookupsAllocated);
         ASSERT(name == tls->classNameLookups[slot]);
         tls->classNameLookups[slot] = nil;
+
+        // Remember the miss. Lookups made from inside a hook are not 
+        // remembered: the hook may still be building what they ask for.
+        if (!result  &&  slot == 0) {
+            objc::addMissingClassName(name, generation);
+        }
     }
 
     return result;
@@ -7382,8 +8407,13 @@ void objc_registerClassPair(Class cls)
     cls->ISA()->changeInfo(RW_CONSTRUCTED, RW_CONSTRUCTING | RW_REALIZING);
     cls->changeInfo(RW_CONSTRUCTED, RW_CONSTRUCTING | RW_REALIZING);
 
-    // Add to named class table.
-    addNamedClass(cls, cls->data()->ro()->name);
+    // Add to named class table. This must follow clearing 
+    // RW_CONSTRUCTING: a constructing class is never published 
+    // to namedClassTable, and nothing else would publish it later.
+    const char *name = cls->data()->ro()->name;
+    addNamedClass(cls, name);
+    ASSERT(NXMapGet(gdb_objc_realized_classes, name) != cls  ||  
+           objc::namedClassTableFind(name) == cls);
 }
 
 
@@ -7478,12 +8508,15 @@ static void free_class(Class cls)
     auto ro = rw->ro();
 
     cache_delete(cls);
+    forgetResolverMisses(cls);
+    forgetConformances();
 
     if (rwe) {
         for (auto& meth : rwe->methods) {
             try_free(meth.types());
         }
         rwe->methods.tryFree();
+        invalidateMethodIndex(rwe);
     }
     
     const ivar_list_t *ivars = ro->ivars;
@@ -7648,6 +8681,13 @@ _class_createInstanceFromZone(Class cls, size_t extraBytes, void *zone,
     }
 
     if (fastpath(!hasCxxCtor)) {
+#if SUPPORT_BIASED_REFCOUNT
+        // Objects with C++ constructors aren't adopted: a failed 
+        // constructor frees them without a release.
+        if (slowpath(EnableBiasedRefcount)  &&  !zone  &&  fast) {
+            obj->biased_adopt();
+        }
+#endif
         return obj;
     }
 
@@ -7781,6 +8821,10 @@ void *objc_destructInstance(id obj)
         // 移除所有的关联对象，并将其自身从 Association Manager 的 map 中移除
         if (assoc) _object_remove_assocations(obj); 
         obj->clearDeallocating();
+#if SUPPORT_BIASED_REFCOUNT
+        // object_dispose() frees objects without releasing them.
+        if (slowpath(EnableBiasedRefcount)) obj->biased_forget();
+#endif
     }
 
     return obj;
@@ -8119,6 +9163,8 @@ static Class setSuperclass(Class cls, Class newSuper)
     ASSERT(cls->isRealized());
     ASSERT(newSuper->isRealized());
 
+    objc::LookupMutation mutation;
+
     oldSuper = cls->superclass;
     removeSubclass(oldSuper, cls);
     removeSubclass(oldSuper->ISA(), cls->ISA());
@@ -71,20 +71,25 @@ const char __objc_nsobject_class_10_7 = 0;
 
 // Settings from environment variables
 #define OPTION(var, env, help) bool var = false;
+#define INT_OPTION(var, env, default, help) int var = default;
 #include "objc-env.h"
 #undef OPTION
+#undef INT_OPTION
 
 struct option_t {
     bool* var;
+    int* intVar;    // instead of var for INT_OPTION
     const char *env;
     const char *help;
     size_t envlen;
 };
 
 const option_t Settings[] = {
-#define OPTION(var, env, help) option_t{&var, #env, help, strlen(#env)}, 
+#define OPTION(var, env, help) option_t{&var, nil, #env, help, strlen(#env)}, 
+#define INT_OPTION(var, env, default, help) option_t{nil, &var, #env, help, strlen(#env)}, 
 #include "objc-env.h"
 #undef OPTION
+#undef INT_OPTION
 };
 
 
@@ -204,6 +209,9 @@ bool
 objc::SafeRanges::find(uintptr_t ptr, uint32_t &pos)
 {
     if (!sorted) {
+#if __OBJC2__
+        LookupMutation mutation;
+#endif
         std::sort(ranges, ranges + count, [](const Range &s1, const Range &s2){
             return s1.start < s2.start;
         });
@@ -234,6 +242,11 @@ objc::SafeRanges::find(uintptr_t ptr, uint32_t &pos)
 void
 objc::SafeRanges::add(uintptr_t start, uintptr_t end)
 {
+#if __OBJC2__
+    // Lock-free method lookup may be reading the ranges.
+    LookupMutation mutation;
+#endif
+
     if (count == size) {
         // Have a typical malloc growth:
         // - size <= 32:  grow by  4
@@ -241,7 +254,14 @@ objc::SafeRanges::add(uintptr_t start, uintptr_t end)
         // - size <= 128: grow by 16
         // ... etc
         size += size < 16 ? 4 : 1 << (fls(size) - 3);
+#if __OBJC2__
+        Range *newRanges = (Range *)malloc(sizeof(Range) * size);
+        if (count) memcpy(newRanges, ranges, sizeof(Range) * count);
+        cache_epoch_retire(ranges, sizeof(Range) * count);
+        ranges = newRanges;
+#else
         ranges = (Range *)realloc(ranges, sizeof(Range) * size);
+#endif
     }
     ranges[count++] = Range{ start, end };
     sorted = false;
@@ -253,6 +273,9 @@ objc::SafeRanges::add(uintptr_t start, uintptr_t end)
 void
 objc::SafeRanges::remove(uintptr_t start, uintptr_t end)
 {
+#if __OBJC2__
+    LookupMutation mutation;
+#endif
     uint32_t pos;
 
     if (!find(start, pos) || ranges[pos].end != end) {
@@ -385,7 +408,8 @@ void environ_init(void)
             if ((size_t)(value - *p) == 1+opt->envlen  &&  
                 0 == strncmp(*p, opt->env, opt->envlen))
             {
-                *opt->var = (0 == strcmp(value, "YES"));
+                if (opt->intVar) *opt->intVar = atoi(value);
+                else *opt->var = (0 == strcmp(value, "YES"));
                 break;
             }
         }            
@@ -426,7 +450,10 @@ void environ_init(void)
         for (size_t i = 0; i < sizeof(Settings)/sizeof(Settings[0]); i++) {
             const option_t *opt = &Settings[i];            
             if (PrintHelp) _objc_inform("%s: %s", opt->env, opt->help);
-            if (PrintOptions && *opt->var) _objc_inform("%s is set", opt->env);
+            if (PrintOptions && opt->intVar) {
+                _objc_inform("%s is %d", opt->env, *opt->intVar);
+            }
+            else if (PrintOptions && *opt->var) _objc_inform("%s is set", opt->env);
         }
     }
 }
@@ -515,6 +542,7 @@ void tls_init(void)
 {
 #if SUPPORT_DIRECT_THREAD_KEYS
     pthread_key_init_np(TLS_DIRECT_KEY, &_objc_pthread_destroyspecific);
+    pthread_key_init_np(SYNC_DATA_DIRECT_KEY, &_objc_sync_thread_exit);
 #else
     _objc_pthread_key = tls_create(&_objc_pthread_destroyspecific);
 #endif
@@ -25,13 +25,117 @@
 
 #include "objc-private.h"
 #include "objc-cache.h"
-#include "DenseMapExtras.h"
 
+#include <atomic>
 
-static objc::ExplicitInitDenseSet<const char *> namedSelectors;
+
+/***********************************************************************
+* Selector table
+* An open-addressed set of selector names, probed linearly.
+* Lookups take no lock. Inserts claim an empty bucket with a CAS, 
+* so two threads registering the same new name agree on one SEL.
+* Growing takes selLock: the grower freezes every empty bucket of the 
+* old table so no insert can land there, copies the names over, and 
+* publishes the new table. Anyone who finds a frozen bucket reloads 
+* the table and tries again.
+* Old tables are never freed because a lock-free reader may still be 
+* probing one. Each is half the size of its successor, so together 
+* they cost less than the live table.
+**********************************************************************/
+#define SEL_TABLE_MIN_SIZE 1024
+#define SEL_TABLE_FROZEN ((const char *)~(uintptr_t)0)
+
+struct SelTable {
+    uint32_t mask;
+    std::atomic<uint32_t> count;
+    std::atomic<const char *> buckets[0];
+
+    uint32_t capacity() const { return mask + 1; }
+
+    static SelTable *create(uint32_t capacity) {
+        auto table = (SelTable *)
+            calloc(1, sizeof(SelTable) + 
+                   capacity * sizeof(std::atomic<const char *>));
+        table->mask = capacity - 1;
+        return table;
+    }
+};
+
+static std::atomic<SelTable *> namedSelectors;
 static SEL search_builtins(const char *key);
 
 
+// Returns the bucket holding name, or the empty or frozen bucket 
+// where the probe ended, or nil if the table is full without name.
+static std::atomic<const char *> *
+sel_table_probe(SelTable *table, const char *name, const char **outValue)
+{
+    uint32_t index = _objc_strhash(name) & table->mask;
+    for (uint32_t n = 0; n < table->capacity(); n++) {
+        auto bucket = &table->buckets[index];
+        const char *value = bucket->load(std::memory_order_acquire);
+        if (!value  ||  value == SEL_TABLE_FROZEN  ||  
+            0 == strcmp(value, name)) 
+        {
+            *outValue = value;
+            return bucket;
+        }
+        index = (index + 1) & table->mask;
+    }
+    return nil;
+}
+
+
+// Replace the current table with one twice its size.
+// Does nothing if someone else already did.
+// Locking: selLock must be held by the caller.
+static void sel_table_grow(SelTable *table)
+{
+    selLock.assertLocked();
+    if (namedSelectors.load(std::memory_order_relaxed) != table) return;
+
+    SelTable *newTable = SelTable::create(table->capacity() * 2);
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < table->capacity(); i++) {
+        const char *value = table->buckets[i].load(std::memory_order_acquire);
+        while (!value) {
+            if (table->buckets[i].compare_exchange_weak
+                (value, SEL_TABLE_FROZEN, std::memory_order_acq_rel, 
+                 std::memory_order_acquire))
+            {
+                value = SEL_TABLE_FROZEN;
+            }
+        }
+        if (value == SEL_TABLE_FROZEN) continue;
+
+        uint32_t index = _objc_strhash(value) & newTable->mask;
+        while (newTable->buckets[index].load(std::memory_order_relaxed)) {
+            index = (index + 1) & newTable->mask;
+        }
+        newTable->buckets[index].store(value, std::memory_order_relaxed);
+        count++;
+    }
+    newTable->count.store(count, std::memory_order_relaxed);
+
+    namedSelectors.store(newTable, std::memory_order_release);
+}
+
+
+static SEL sel_table_find(const char *name)
+{
+    for (;;) {
+        SelTable *table = namedSelectors.load(std::memory_order_acquire);
+        const char *value;
+        if (!sel_table_probe(table, name, &value)) return nil;
+        if (value != SEL_TABLE_FROZEN) return (SEL)value;
+        // Frozen by a grower. Wait for the new table if it isn't out yet.
+        if (namedSelectors.load(std::memory_order_acquire) == table) {
+            mutex_locker_t lock(selLock);
+        }
+    }
+}
+
+
 /***********************************************************************
 * sel_init
 * Initialize selector tables and register selectors used internally.
@@ -44,7 +148,10 @@ void sel_init(size_t selrefCount)
     }
 #endif
 
-  namedSelectors.init((unsigned)selrefCount);
+    uint32_t capacity = SEL_TABLE_MIN_SIZE;
+    while (capacity * 3 / 4 < selrefCount) capacity *= 2;
+    namedSelectors.store(SelTable::create(capacity), 
+                         std::memory_order_release);
 
     // Register selectors used by libobjc
 
@@ -57,7 +164,6 @@ void sel_init(size_t selrefCount)
 
 static SEL sel_alloc(const char *name, bool copy)
 {
-    selLock.assertLocked();
     return (SEL)(copy ? strdupIfMutable(name) : name);    
 }
 
@@ -77,9 +183,7 @@ BOOL sel_isMapped(SEL sel)
 
     if (sel == search_builtins(name)) return YES;
 
-    mutex_locker_t lock(selLock);
-    auto it = namedSelectors.get().find(name);
-    return it != namedSelectors.get().end() && (SEL)*it == sel;
+    return sel == sel_table_find(name);
 }
 
 
@@ -104,14 +208,48 @@ static SEL __sel_registerName(const char *name, bool shouldLock, bool copy)
 
     result = search_builtins(name);
     if (result) return result;
-    
-    conditional_mutex_locker_t lock(selLock, shouldLock);
-	auto it = namedSelectors.get().insert(name);
-	if (it.second) {
-		// No match. Insert.
-		*it.first = (const char *)sel_alloc(name, copy);
-	}
-	return (SEL)*it.first;
+
+    // Names in mapped images are used in place. Anything else is 
+    // copied once, and the copy is dropped if another thread wins.
+    const char *newName = nil;
+
+    for (;;) {
+        SelTable *table = namedSelectors.load(std::memory_order_acquire);
+        const char *value;
+        auto bucket = sel_table_probe(table, name, &value);
+
+        if (bucket  &&  value  &&  value != SEL_TABLE_FROZEN) {
+            result = (SEL)value;
+            break;
+        }
+
+        if (bucket  &&  !value) {
+            if (!newName) newName = (const char *)sel_alloc(name, copy);
+            if (!bucket->compare_exchange_strong
+                (value, newName, std::memory_order_acq_rel, 
+                 std::memory_order_acquire))
+            {
+                // Lost the race for this bucket. Probe again.
+                continue;
+            }
+            result = (SEL)newName;
+            newName = nil;
+            uint32_t count = 1 + 
+                table->count.fetch_add(1, std::memory_order_relaxed);
+            if (count <= table->capacity() * 3 / 4) break;
+            // Fall through to grow. The name is already in the table.
+        }
+
+        // The table is full, frozen, or just became too full.
+        {
+            conditional_mutex_locker_t lock(selLock, shouldLock);
+            sel_table_grow(table);
+        }
+        if (result) break;
+    }
+
+    if (newName  &&  newName != name) free((void *)newName);
+    return result;
 }
 
 
@@ -25,15 +25,19 @@
 #include "objc-sync.h"
 
 //
-// Allocate a lock only when needed.  Since few locks are needed at any point
-// in time, keep them on a single list.
+// Allocate a lock only when needed. Locks are found by hashing the object 
+// address: first into one of several stripes, then within the stripe's 
+// open-addressed table.
 //
 
 #pragma mark - @synchonized
 typedef struct alignas(CacheLineSize) SyncData {
-    struct SyncData* nextData; //链表?
+    struct SyncData* nextData; // free list link while unused
     DisguisedPtr<objc_object> object; //传入的对象
     int32_t threadCount;  // number of THREADS using this block 使用这个block的线程个数
+    int32_t spinLimit;    // adaptive spin count before parking; racy hint only
+    uint32_t lockDepth;   // OBJC_PROFILE_LOCKS only: owner's recursion depth
+    uint64_t lockedAt;    // OBJC_PROFILE_LOCKS only: time of outermost lock
     recursive_mutex_t mutex; //递归锁 os_unfair_recursive_lock
 } SyncData;
 
@@ -54,20 +58,127 @@ typedef struct SyncCache {
   a single object at a time.
   SYNC_DATA_DIRECT_KEY  == SyncCacheItem.data
   SYNC_COUNT_DIRECT_KEY == SyncCacheItem.lockCount
+
+  The fast cache is biased towards its thread. When the lock count drops 
+  to zero the SyncData stays in the fast cache and keeps its threadCount, 
+  so synchronizing on the same object again from the same thread finds it 
+  without touching the shared table. The bias is dropped when the thread 
+  acquires a different object or exits.
  */
 
+// Each stripe keeps its SyncData in an open-addressed table keyed by 
+// object address. Entries are never removed individually. A SyncData 
+// whose threadCount drops to zero stays in the table under its old 
+// object until the table fills up, at which point the table is rebuilt 
+// and every unused SyncData moves to the stripe's free list.
 struct SyncList {
-    SyncData *data;
+    SyncData **buckets;  // nil until the first insertion
+    uint32_t mask;       // bucket count - 1
+    uint32_t count;      // SyncData in buckets
+    SyncData *freeList;  // unused SyncData, linked by nextData
     spinlock_t lock;
 
-    constexpr SyncList() : data(nil), lock(fork_unsafe_lock) { }
+    constexpr SyncList() 
+        : buckets(nil), mask(0), count(0), freeList(nil), 
+          lock(fork_unsafe_lock) { }
 };
 
+#define SYNC_TABLE_MIN_SIZE 8
+
 // Use multiple parallel lists to decrease contention among unrelated objects.
 #define LOCK_FOR_OBJ(obj) sDataLists[obj].lock
-#define LIST_FOR_OBJ(obj) sDataLists[obj].data
+#define LIST_FOR_OBJ(obj) sDataLists[obj]
 static StripedMap<SyncList> sDataLists;
 
+static inline uint32_t sync_hash(id object)
+{
+    return ptr_hash((uintptr_t)object);
+}
+
+// Returns the SyncData for object, or nil. list->lock must be held.
+static SyncData *sync_table_find(SyncList *list, id object)
+{
+    if (!list->buckets) return nil;
+    uint32_t index = sync_hash(object) & list->mask;
+    while (SyncData *p = list->buckets[index]) {
+        if (p->object == object) return p;
+        index = (index + 1) & list->mask;
+    }
+    return nil;
+}
+
+static void sync_table_insert_no_grow(SyncList *list, SyncData *data)
+{
+    uint32_t index = sync_hash((id)data->object) & list->mask;
+    while (list->buckets[index]) {
+        index = (index + 1) & list->mask;
+    }
+    list->buckets[index] = data;
+    list->count++;
+}
+
+// Moves unused SyncData to the free list and resizes the table so that 
+// the SyncData still in use fill at most half of it.
+static void sync_table_rebuild(SyncList *list)
+{
+    SyncData **oldBuckets = list->buckets;
+    uint32_t oldSize = oldBuckets ? list->mask + 1 : 0;
+
+    // threadCount can drop to zero concurrently but only rises 
+    // under the lock, so this is an upper bound on what is reinserted.
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < oldSize; i++) {
+        if (oldBuckets[i]  &&  oldBuckets[i]->threadCount > 0) live++;
+    }
+
+    uint32_t size = oldSize ? oldSize : SYNC_TABLE_MIN_SIZE;
+    while (live * 2 >= size) size *= 2;
+
+    list->buckets = (SyncData **)calloc(size, sizeof(SyncData *));
+    list->mask = size - 1;
+    list->count = 0;
+
+    for (uint32_t i = 0; i < oldSize; i++) {
+        SyncData *p = oldBuckets[i];
+        if (!p) continue;
+        if (p->threadCount > 0) {
+            sync_table_insert_no_grow(list, p);
+        } else {
+            p->nextData = list->freeList;
+            list->freeList = p;
+        }
+    }
+    free(oldBuckets);
+}
+
+// Adds a SyncData for object, reusing an unused one if possible.
+// list->lock must be held.
+static SyncData *sync_table_add(SyncList *list, id object)
+{
+    if (!list->buckets  ||  (list->count + 1) * 4 > (list->mask + 1) * 3) {
+        sync_table_rebuild(list);
+    }
+
+    SyncData *result = list->freeList;
+    if (result) {
+        list->freeList = result->nextData;
+    } else {
+        // XXX allocating memory with a global lock held is bad practice,
+        // might be worth releasing the lock, allocating, and searching again.
+        // But since we never free these guys we won't be stuck in allocation very often.
+        posix_memalign((void **)&result, alignof(SyncData), sizeof(SyncData));
+        result->spinLimit = 0;
+        result->lockDepth = 0;
+        result->lockedAt = 0;
+        new (&result->mutex) recursive_mutex_t(fork_unsafe_lock);
+    }
+    result->nextData = nil;
+    result->object = (objc_object *)object;
+    result->threadCount = 1;
+    sync_table_insert_no_grow(list, result);
+    return result;
+}
+
 
 enum usage { ACQUIRE, RELEASE, CHECK };
 
@@ -110,7 +221,7 @@ void _destroySyncCache(struct SyncCache *cache)
 static SyncData* id2data(id object, enum usage why)
 {
     spinlock_t *lockp = &LOCK_FOR_OBJ(object);
-    SyncData **listp = &LIST_FOR_OBJ(object);
+    SyncList *listp = &LIST_FOR_OBJ(object);
     SyncData* result = NULL;
 
 #if SUPPORT_DIRECT_THREAD_KEYS
@@ -118,15 +229,13 @@ static SyncData* id2data(id object, enum usage why)
     bool fastCacheOccupied = NO;
     SyncData *data = (SyncData *)tls_get_direct(SYNC_DATA_DIRECT_KEY);
     if (data) {
+        uintptr_t lockCount = (uintptr_t)tls_get_direct(SYNC_COUNT_DIRECT_KEY);
         fastCacheOccupied = YES;
 
         if (data->object == object) {
             // Found a match in fast cache.
-            uintptr_t lockCount;
-
             result = data;
-            lockCount = (uintptr_t)tls_get_direct(SYNC_COUNT_DIRECT_KEY);
-            if (result->threadCount <= 0  ||  lockCount <= 0) {
+            if (result->threadCount <= 0) {
                 _objc_fatal("id2data fastcache is buggy");
             }
 
@@ -137,14 +246,11 @@ static SyncData* id2data(id object, enum usage why)
                 break;
             }
             case RELEASE:
+                // Biased to this thread but not locked by it.
+                if (lockCount == 0) return nil;
+                // Stays in the fast cache when the count reaches zero.
                 lockCount--;
                 tls_set_direct(SYNC_COUNT_DIRECT_KEY, (void*)lockCount);
-                if (lockCount == 0) {
-                    // remove from fast cache
-                    tls_set_direct(SYNC_DATA_DIRECT_KEY, NULL);
-                    // atomic because may collide with concurrent ACQUIRE
-                    OSAtomicDecrement32Barrier(&result->threadCount);
-                }
                 break;
             case CHECK:
                 // do nothing
@@ -153,6 +259,15 @@ static SyncData* id2data(id object, enum usage why)
 
             return result;
         }
+
+        if (lockCount == 0  &&  why == ACQUIRE) {
+            // Drop the bias towards an object this thread no longer holds
+            // so the fast cache can take the new one.
+            tls_set_direct(SYNC_DATA_DIRECT_KEY, NULL);
+            // atomic because may collide with concurrent ACQUIRE
+            OSAtomicDecrement32Barrier(&data->threadCount);
+            fastCacheOccupied = NO;
+        }
     }
 #endif
 
@@ -193,53 +308,21 @@ static SyncData* id2data(id object, enum usage why)
     }
 
     // Thread cache didn't find anything.
-    // Walk in-use list looking for matching object
+    // Look up the object in the stripe's table.
     // Spinlock prevents multiple threads from creating multiple 
     // locks for the same new object.
-    // We could keep the nodes in some hash table if we find that there are
-    // more than 20 or so distinct locks active, but we don't do that now.
     
     lockp->lock();
 
-    {
-        SyncData* p;
-        SyncData* firstUnused = NULL;
-        for (p = *listp; p != NULL; p = p->nextData) {
-            if ( p->object == object ) {
-                result = p;
-                // atomic because may collide with concurrent RELEASE
-                OSAtomicIncrement32Barrier(&result->threadCount);
-                goto done;
-            }
-            if ( (firstUnused == NULL) && (p->threadCount == 0) )
-                firstUnused = p;
-        }
-    
+    result = sync_table_find(listp, object);
+    if (result) {
+        // atomic because may collide with concurrent RELEASE
+        OSAtomicIncrement32Barrier(&result->threadCount);
+    } else if (why == ACQUIRE) {
         // no SyncData currently associated with object
-        if ( (why == RELEASE) || (why == CHECK) )
-            goto done;
-    
-        // an unused one was found, use it
-        if ( firstUnused != NULL ) {
-            result = firstUnused;
-            result->object = (objc_object *)object;
-            result->threadCount = 1;
-            goto done;
-        }
+        result = sync_table_add(listp, object);
     }
 
-    // Allocate a new SyncData and add to list.
-    // XXX allocating memory with a global lock held is bad practice,
-    // might be worth releasing the lock, allocating, and searching again.
-    // But since we never free these guys we won't be stuck in allocation very often.
-    posix_memalign((void **)&result, alignof(SyncData), sizeof(SyncData));
-    result->object = (objc_object *)object;
-    result->threadCount = 1;
-    new (&result->mutex) recursive_mutex_t(fork_unsafe_lock);
-    result->nextData = *listp;
-    *listp = result;
-    
- done:
     lockp->unlock();
     if (result) {
         // Only new ACQUIRE should get here.
@@ -273,6 +356,83 @@ static SyncData* id2data(id object, enum usage why)
 }
 
 
+#if SUPPORT_DIRECT_THREAD_KEYS
+// Destructor for SYNC_DATA_DIRECT_KEY. 
+// Drops the exiting thread's bias if it no longer holds the lock.
+void _objc_sync_thread_exit(void *arg)
+{
+    SyncData *data = (SyncData *)arg;
+    if (data  &&  tls_get_direct(SYNC_COUNT_DIRECT_KEY) == 0) {
+        OSAtomicDecrement32Barrier(&data->threadCount);
+    }
+}
+#endif
+
+
+#define SYNC_SPIN_MAX 100
+
+static ALWAYS_INLINE void sync_spin_pause()
+{
+#if __x86_64__  ||  __i386__
+    __builtin_ia32_pause();
+#elif __arm64__  ||  __arm__
+    __asm__ volatile("yield");
+#endif
+}
+
+// Contended locks spin briefly before parking in the kernel. 
+// Each SyncData remembers how long recent acquisitions spun and 
+// adjusts its budget towards that, so locks held only briefly 
+// are taken without a context switch and locks held for a long 
+// time stop wasting CPU on spinning.
+static void sync_lock_contended(SyncData *data)
+{
+    int32_t limit = std::min(data->spinLimit * 2 + 10, SYNC_SPIN_MAX);
+    for (int32_t spins = 1; spins <= limit; spins++) {
+        sync_spin_pause();
+        if (data->mutex.tryLock()) {
+            data->spinLimit += (spins - data->spinLimit) / 8;
+            return;
+        }
+    }
+    data->spinLimit += (limit - data->spinLimit) / 8;
+    data->mutex.lock();
+}
+
+// OBJC_PROFILE_LOCKS: called by the owner after every acquisition 
+// and before every release. Hold time runs from the outermost 
+// acquisition to the matching release.
+static void sync_profile_locked(SyncData *data, id obj, 
+                                bool contended, uint64_t waitNanos)
+{
+    if (data->lockDepth++ == 0) data->lockedAt = nanoseconds();
+    lockprofile_sync_locked(obj->getIsa(), contended, waitNanos);
+}
+
+static void sync_profile_unlocking(SyncData *data, id obj)
+{
+    if (data->lockDepth > 0  &&  --data->lockDepth == 0) {
+        lockprofile_sync_unlocked(obj->getIsa(), nanoseconds() - data->lockedAt);
+    }
+}
+
+static void sync_lock(SyncData *data, id obj)
+{
+    if (fastpath(data->mutex.tryLock())) {
+        if (slowpath(lockprofile_enabled)) {
+            sync_profile_locked(data, obj, false, 0);
+        }
+        return;
+    }
+
+    uint64_t start = lockprofile_enabled ? nanoseconds() : 0;
+    sync_lock_contended(data);
+    if (slowpath(lockprofile_enabled)) {
+        sync_profile_locked(data, obj, true, nanoseconds() - start);
+    }
+}
+
+
 BREAKPOINT_FUNCTION(
     void objc_sync_nil(void)
 );
@@ -290,7 +450,7 @@ int objc_sync_enter(id obj)
     if (obj) {
         SyncData* data = id2data(obj, ACQUIRE);
         ASSERT(data);
-        data->mutex.lock();
+        sync_lock(data, obj);
     } else {
         // @synchronized(nil) does nothing
         //如果obj是nil,什么也不做
@@ -311,6 +471,9 @@ BOOL objc_sync_try_enter(id obj)
         SyncData* data = id2data(obj, ACQUIRE);
         ASSERT(data);
         result = data->mutex.tryLock();
+        if (result  &&  slowpath(lockprofile_enabled)) {
+            sync_profile_locked(data, obj, false, 0);
+        }
     } else {
         // @synchronized(nil) does nothing
         if (DebugNilSync) {
@@ -334,6 +497,9 @@ int objc_sync_exit(id obj)
         if (!data) {
             result = OBJC_SYNC_NOT_OWNING_THREAD_ERROR;
         } else {
+            // Only the owner gets here unless the thread caches are wrong, 
+            // in which case tryUnlock fails below.
+            if (slowpath(lockprofile_enabled)) sync_profile_unlocking(data, obj);
             bool okay = data->mutex.tryUnlock();
             if (!okay) {
                 result = OBJC_SYNC_NOT_OWNING_THREAD_ERROR;
@@ -169,6 +169,15 @@ struct weak_table_t {
     // 所以某个 weak_entry_t 实际存储的位置并不一定是 hash 函数计算出来的位置
 
     uintptr_t max_hash_displacement;
+
+    // Incremental resizing. While old_entries is set, the entries at 
+    // old_next and above that haven't moved to weak_entries yet are 
+    // still in old_entries. Lookups search both arrays. num_entries 
+    // counts the entries in both.
+    weak_entry_t *old_entries;
+    uintptr_t old_mask;
+    uintptr_t old_max_hash_displacement;
+    size_t old_next;
 };
 
 /// Adds an (object, weak pointer) pair to the weak table.
@@ -186,6 +195,10 @@ bool weak_is_registered_no_lock(weak_table_t *weak_table, id referent);
 /// Called on object destruction. Sets all remaining weak pointers to nil.
 void weak_clear_no_lock(weak_table_t *weak_table, id referent);
 
+/// Adds weak_table's size and probe statistics to stats.
+void weak_table_statistics_no_lock(weak_table_t *weak_table, 
+                                   objc_weak_table_statistics *stats);
+
 __END_DECLS
 
 #endif /* _OBJC_WEAK_H_ */
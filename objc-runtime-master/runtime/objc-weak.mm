@@ -319,10 +319,46 @@ static void weak_entry_insert(weak_table_t *weak_table, weak_entry_t *new_entry)
 // weak_resize对哈希数组进行的扩大或缩小，首先根据 new_size 申请相应大小的内存，new_entries 指针指向这块新申请的内存。设置 weak_table 的 mask 为 new_size - 1。此处 mask 的作用是记录 weak_table 总容量的内存边界，此外 mask 还用在哈希函数中保证 index 不会哈希数组越界。
 // weak_table_t 的哈希数组可能会发生哈希碰撞，而 weak_table_t 使用了开放寻址法来处理碰撞。如果发生碰撞的话，将寻找相邻（如果已经到最尾端的话，则从头开始）的下一个空位。max_hash_displacement 记录当前 weak_table 发生过的最大的偏移值。此值会在其他地方用到，例如：weak_entry_for_referent 函数，寻找给定的 referent 的在弱引用表中的 entry 时，如果在循环过程中 hash_displacement 的值超过了 weak_table->max_hash_displacement 则表示，不存在要找的 weak_entry_t。
 
+// Number of old slots each weak table operation moves during a resize.
+#define WEAK_RESIZE_STEP 64
+
+// Move up to `slots` slots of a resize in progress to the new array.
+static void weak_resize_step(weak_table_t *weak_table, size_t slots)
+{
+    weak_entry_t *old_entries = weak_table->old_entries;
+    if (fastpath(!old_entries)) return;
+
+    size_t old_size = weak_table->old_mask + 1;
+    size_t end = weak_table->old_next + std::min(slots, old_size);
+    if (end > old_size) end = old_size;
+
+    for (size_t i = weak_table->old_next; i < end; i++) {
+        weak_entry_t *entry = &old_entries[i];
+        if (entry->referent) {
+            weak_entry_insert(weak_table, entry);
+            weak_table->num_entries--;  // moved, not added
+            bzero(entry, sizeof(*entry));
+        }
+    }
+    weak_table->old_next = end;
+
+    if (end == old_size) {
+        free(old_entries);
+        weak_table->old_entries = nil;
+        weak_table->old_mask = 0;
+        weak_table->old_max_hash_displacement = 0;
+        weak_table->old_next = 0;
+    }
+}
+
+// Start moving the table to a new array of new_size entries. 
+// The entries move a few at a time (weak_resize_step()), so no single 
+// operation rehashes the whole table while the SideTable lock is held.
 static void weak_resize(weak_table_t *weak_table, size_t new_size)
 {
-    //// old_size = mask + 1; 表示原哈希数组的总长度
-    size_t old_size = TABLE_SIZE(weak_table);
+    // Finish the previous resize first. The step size makes this rare: 
+    // the new array can't fill up before the old one is drained.
+    weak_resize_step(weak_table, SIZE_MAX);
 
     //// 旧的 weak_entries 哈希数组起始地址
     weak_entry_t *old_entries = weak_table->weak_entries;
@@ -332,6 +368,14 @@ static void weak_resize(weak_table_t *weak_table, size_t new_size)
     weak_entry_t *new_entries = (weak_entry_t *)
         calloc(new_size, sizeof(weak_entry_t));
 
+    if (old_entries) {
+        weak_table->old_entries = old_entries;
+        weak_table->old_mask = weak_table->mask;
+        weak_table->old_max_hash_displacement = 
+            weak_table->max_hash_displacement;
+        weak_table->old_next = 0;
+    }
+
     // 更新 mask ，仍是总长度减 1
     weak_table->mask = new_size - 1;
     // 更新 hash 数组起始地址
@@ -339,26 +383,6 @@ static void weak_resize(weak_table_t *weak_table, size_t new_size)
     
     // 最大哈希冲突偏移值，默认为 0
     weak_table->max_hash_displacement = 0;
-    // 当前哈希数组的占用数量，默认为 0
-    weak_table->num_entries = 0;  // restored by weak_entry_insert below
-    
-    // 以上 weak_table_t 的两个成员变量会在下面的 weak_entry_insert 函数中得到更新
-        
-    // 如果有旧 weak_entry_t 需要放到新空间内
-    if (old_entries) {
-        weak_entry_t *entry;
-        // 旧哈希数组的末尾
-        weak_entry_t *end = old_entries + old_size;
-        
-        // 循环调用 weak_entry_insert 把旧哈希数组中的 weak_entry_t 插入到新的哈希数组中
-        for (entry = old_entries; entry < end; entry++) {
-            if (entry->referent) {
-                weak_entry_insert(weak_table, entry);
-            }
-        }
-        // 最后释放旧的哈希数组的空间
-        free(old_entries);
-    }
 }
 
 // Grow the given zone's table of weak references if it is full.
@@ -394,6 +418,9 @@ static void weak_compact_maybe(weak_table_t *weak_table)
 
     // Shrink if larger than 1024 buckets and at most 1/16 full.
     // old_size 超过了 1024 并且 低于 1/16 的空间占用k率则进行缩小
+    // Wait for a resize in progress to finish.
+    if (weak_table->old_entries) return;
+
     if (old_size >= 1024  && old_size / 16 >= weak_table->num_entries) {
         // 缩小容量为 ols_size 的 1/8
         weak_resize(weak_table, old_size / 8);
@@ -438,40 +465,52 @@ static void weak_entry_remove(weak_table_t *weak_table, weak_entry_t *entry)
 //根据给定的 referent 和 weak_table_t 哈希表，查找其中的 weak_entry_t 并返回，如果未找到则返回 NULL。
 
 static weak_entry_t *
-weak_entry_for_referent(weak_table_t *weak_table, objc_object *referent)
+weak_entry_probe(weak_entry_t *weak_entries, uintptr_t mask, 
+                 uintptr_t max_hash_displacement, objc_object *referent)
 {
-    ASSERT(referent);
-
-    // weak_table_t 中哈希数组的入口
-    weak_entry_t *weak_entries = weak_table->weak_entries;
-
     if (!weak_entries) return nil;
     
     // 哈希函数：hash_pointer 函数返回值与 mask 做与操作，防止 index 越界
-    size_t begin = hash_pointer(referent) & weak_table->mask;
+    size_t begin = hash_pointer(referent) & mask;
     //首先是 mask 的值一直是 2 的 N 次方减 1 ，根据 weak_grow_maybe 函数，我们会看到哈希数组（weak_entry_t *weak_entries）的长度最小是 64，即 2 的 6 次方（N >= 6），以后的每次扩容是之前的长度乘以 2，即总长度永远是 2 的 N 次方，然后 mask 是 2 的 N 次方减 1，转为二进制的话：mask 一直是: 0x0111111(64 - 1，N = 6)、0x01111111(128 -1，N = 7)...., 即 mask 的二进制表示中后 N 位总是 1，之前的位总是 0，所以任何数与 mask 做与操作的结果总是在 [0, mask] 这个区间内。例如任何数与 0x0111111(64 - 1，N = 6) 做与操作的话结果总是在 [0, 63] 这个区间内。而这个正是 weak_entry_t *weak_entries 数组的下标范围。
 
     size_t index = begin;
     size_t hash_displacement = 0;
     
-    // 如果未发生哈希冲突的话，这 weak_table->weak_entries[index] 就是要找的 weak_entry_t
-    while (weak_table->weak_entries[index].referent != referent) {
+    // 如果未发生哈希冲突的话，这 weak_entries[index] 就是要找的 weak_entry_t
+    while (weak_entries[index].referent != referent) {
         // 如果发生了哈希冲突，+1 继续往下探测（开放寻址法）
-        index = (index+1) & weak_table->mask;
+        index = (index+1) & mask;
         
         // 如果 index 每次加 1 加到值等于 begin 还没有找到 weak_entry_t，则触发 bad_weak_table 致命错误
-        if (index == begin) bad_weak_table(weak_table->weak_entries);
+        if (index == begin) bad_weak_table(weak_entries);
         
         // 记录探测偏移了多远
         hash_displacement++;
         // 如果探测偏移超过了 weak_table_t 的 max_hash_displacement，
         // 说明在 weak_table 中没有 referent 的 weak_entry_t，则直接返回 nil
-        if (hash_displacement > weak_table->max_hash_displacement) {
+        if (hash_displacement > max_hash_displacement) {
             return nil;
         }
     }
     // 到这里遍找到了 weak_entry_t，然后取它的地址返回
-    return &weak_table->weak_entries[index];
+    return &weak_entries[index];
+}
+
+static weak_entry_t *
+weak_entry_for_referent(weak_table_t *weak_table, objc_object *referent)
+{
+    ASSERT(referent);
+
+    weak_entry_t *entry = 
+        weak_entry_probe(weak_table->weak_entries, weak_table->mask, 
+                         weak_table->max_hash_displacement, referent);
+    if (!entry  &&  slowpath(weak_table->old_entries)) {
+        entry = weak_entry_probe(weak_table->old_entries, weak_table->old_mask,
+                                 weak_table->old_max_hash_displacement, 
+                                 referent);
+    }
+    return entry;
 }
 
 /** 
@@ -503,6 +542,7 @@ weak_unregister_no_lock(weak_table_t *weak_table, id referent_id,
     weak_entry_t *entry;
 
     if (!referent) return;
+    weak_resize_step(weak_table, WEAK_RESIZE_STEP);
     // 从 weak_table 中找到 referent 的 weak_entry_t
     if ((entry = weak_entry_for_referent(weak_table, referent))) {
         // 找到了这个 entry，就删除 weak_entry_t 的哈希数组（或定长为 4 的内部数组）中的 referrer
@@ -597,6 +637,7 @@ weak_register_no_lock(weak_table_t *weak_table, id referent_id,
 
     // now remember it and where it is being stored
     // 在 weak_table 中找 referent 对应的 weak_entry_t
+    weak_resize_step(weak_table, WEAK_RESIZE_STEP);
     weak_entry_t *entry;
     if ((entry = weak_entry_for_referent(weak_table, referent))) {
         // 如果找到了，调用 append_referrer，把 __weak 变量的地址放进哈希数组
@@ -647,6 +688,8 @@ weak_clear_no_lock(weak_table_t *weak_table, id referent_id)
     // referent 待销毁的对象
     objc_object *referent = (objc_object *)referent_id;
 
+    weak_resize_step(weak_table, WEAK_RESIZE_STEP);
+
     // 从 weak_table_t 的哈希数组中找到 referent 对应的 weak_entry_t
     weak_entry_t *entry = weak_entry_for_referent(weak_table, referent);
     // 如果 entry 不存在，则返回
@@ -708,3 +751,24 @@ weak_clear_no_lock(weak_table_t *weak_table, id referent_id)
     weak_entry_remove(weak_table, entry);
 }
 
+
+/** 
+ * Adds this table's size and probe statistics to stats.
+ */
+void
+weak_table_statistics_no_lock(weak_table_t *weak_table, 
+                              objc_weak_table_statistics *stats)
+{
+    stats->entries += weak_table->num_entries;
+    stats->capacity += TABLE_SIZE(weak_table);
+    if (weak_table->max_hash_displacement > stats->maxDisplacement) {
+        stats->maxDisplacement = weak_table->max_hash_displacement;
+    }
+    if (weak_table->old_entries) {
+        stats->capacity += weak_table->old_mask + 1;
+        if (weak_table->old_max_hash_displacement > stats->maxDisplacement) {
+            stats->maxDisplacement = weak_table->old_max_hash_displacement;
+        }
+        stats->resizing++;
+    }
+}
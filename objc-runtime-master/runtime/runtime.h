@@ -1762,6 +1762,10 @@ typedef BOOL (*objc_hook_getClass)(const char * _Nonnull name, Class _Nullable *
  *  setter completes.
  * @note Your hook should call the previous hook for class names
  *  that you do not recognize.
+ * @note A name that no class or hook recognizes may be remembered as
+ *  missing, and your hook may not be asked about it again until a class
+ *  is added, an image is loaded, or a hook is installed. Your hook
+ *  should answer NO only for names that stay unknown until then.
  *
  * @see objc_getClass
  * @see objc_hook_getClass
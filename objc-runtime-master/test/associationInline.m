@@ -0,0 +1,80 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+
+// An object's first two associations are stored inline. A third key
+// moves them all to a separate map. Values must survive the move and
+// be released exactly once however they are stored.
+
+#define KEYS 5
+
+static const char keys[KEYS] = {0};
+
+static void check(int keyCount)
+{
+    TestRoot *obj = [TestRoot new];
+    id values[KEYS];
+
+    TestRootDealloc = 0;
+    for (int i = 0; i < keyCount; i++) {
+        values[i] = [TestRoot new];
+        objc_setAssociatedObject(obj, &keys[i], values[i],
+                                 OBJC_ASSOCIATION_RETAIN);
+        [values[i] release];
+    }
+    for (int i = 0; i < keyCount; i++) {
+        testassert(objc_getAssociatedObject(obj, &keys[i]) == values[i]);
+    }
+    testassert(objc_getAssociatedObject(obj, &keys[KEYS-1]) ==
+               (keyCount == KEYS ? values[KEYS-1] : nil));
+
+    // Replace the first value.
+    id replacement = [TestRoot new];
+    objc_setAssociatedObject(obj, &keys[0], replacement,
+                             OBJC_ASSOCIATION_RETAIN);
+    [replacement release];
+    testassert(TestRootDealloc == 1);
+    testassert(objc_getAssociatedObject(obj, &keys[0]) == replacement);
+
+    // Remove the first key. The others must still be found.
+    objc_setAssociatedObject(obj, &keys[0], nil, OBJC_ASSOCIATION_RETAIN);
+    testassert(TestRootDealloc == 2);
+    testassert(objc_getAssociatedObject(obj, &keys[0]) == nil);
+    for (int i = 1; i < keyCount; i++) {
+        testassert(objc_getAssociatedObject(obj, &keys[i]) == values[i]);
+    }
+
+    // Re-adding a key after removal works.
+    id again = [TestRoot new];
+    objc_setAssociatedObject(obj, &keys[0], again, OBJC_ASSOCIATION_RETAIN);
+    [again release];
+    testassert(objc_getAssociatedObject(obj, &keys[0]) == again);
+
+    // Dealloc releases everything left.
+    [obj release];
+    testassert(TestRootDealloc == 1 + 1 + 1 + keyCount);
+}
+
+int main()
+{
+    for (int keyCount = 1; keyCount <= KEYS; keyCount++) {
+        check(keyCount);
+    }
+
+    // Removing every key leaves the object with no associations.
+    TestRoot *obj = [TestRoot new];
+    for (int i = 0; i < KEYS; i++) {
+        objc_setAssociatedObject(obj, &keys[i], obj, OBJC_ASSOCIATION_ASSIGN);
+    }
+    for (int i = 0; i < KEYS; i++) {
+        objc_setAssociatedObject(obj, &keys[i], nil, OBJC_ASSOCIATION_ASSIGN);
+        testassert(objc_getAssociatedObject(obj, &keys[i]) == nil);
+    }
+    TestRootDealloc = 0;
+    [obj release];
+    testassert(TestRootDealloc == 1);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,68 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <pthread.h>
+#include <objc/runtime.h>
+
+// Associated objects are stored in shards chosen by object address.
+// Many threads setting, getting, and removing associations on their
+// own objects must not lose or leak any value.
+
+#define THREADS 8
+#define OBJECTS 64
+#define ROUNDS 200
+
+static const char key1 = 0;
+static const char key2 = 0;
+
+static void *threadfn(void *arg __unused)
+{
+    for (int n = 0; n < ROUNDS; n++) {
+        id objs[OBJECTS];
+        id values[OBJECTS];
+        for (int i = 0; i < OBJECTS; i++) {
+            objs[i] = [TestRoot new];
+            values[i] = [TestRoot new];
+            objc_setAssociatedObject(objs[i], &key1, values[i],
+                                     OBJC_ASSOCIATION_RETAIN);
+            objc_setAssociatedObject(objs[i], &key2, values[i],
+                                     OBJC_ASSOCIATION_ASSIGN);
+            [values[i] release];
+        }
+        for (int i = 0; i < OBJECTS; i++) {
+            testassert(objc_getAssociatedObject(objs[i], &key1) == values[i]);
+            testassert(objc_getAssociatedObject(objs[i], &key2) == values[i]);
+            if (i & 1) {
+                objc_setAssociatedObject(objs[i], &key1, nil,
+                                         OBJC_ASSOCIATION_RETAIN);
+                testassert(objc_getAssociatedObject(objs[i], &key1) == nil);
+            }
+        }
+        for (int i = 0; i < OBJECTS; i++) {
+            [objs[i] release];
+        }
+    }
+    return NULL;
+}
+
+int main()
+{
+    // Objects that never had an association.
+    TestRoot *obj = [TestRoot new];
+    testassert(objc_getAssociatedObject(obj, &key1) == nil);
+    testassert(objc_getAssociatedObject(nil, &key1) == nil);
+    [obj release];
+
+    TestRootDealloc = 0;
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &threadfn, NULL);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    testassert(TestRootDealloc == THREADS * ROUNDS * OBJECTS * 2);
+
+    succeed(__FILE__);
+}
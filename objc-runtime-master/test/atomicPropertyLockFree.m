@@ -0,0 +1,120 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include <pthread.h>
+#include <Foundation/NSObject.h>
+#include <objc/objc-abi.h>
+
+// Atomic property getters read without the PropertyLocks and StructLocks
+// stripes. A getter racing a setter must return either the old or the
+// new value, retained and never freed, and atomic structs must never
+// be seen half written. Struct copies between two shared locations in 
+// opposite directions must not deadlock.
+
+#define READERS 4
+#define ROUNDS 50000
+
+static int deallocs;
+
+@interface Value : NSObject {
+  @public
+    int canary;
+}
+@end
+@implementation Value
+-(void)dealloc {
+    canary = 0;
+    __sync_fetch_and_add(&deallocs, 1);
+    [super dealloc];
+}
+@end
+
+typedef struct {
+    long a, b, c, d;
+} Quad;
+
+@interface Holder : NSObject
+@property (atomic, retain) Value *value;
+@property (atomic) Quad quad;
+@end
+@implementation Holder
+@synthesize value, quad;
+@end
+
+static Holder *holder;
+static volatile bool done;
+
+static void *reader(void *arg __unused)
+{
+    while (!done) @autoreleasepool {
+        Value *v = holder.value;
+        if (v) testassert(v->canary == 42);
+        Quad q = holder.quad;
+        testassert(q.a == q.b  &&  q.b == q.c  &&  q.c == q.d);
+    }
+    return NULL;
+}
+
+static Quad *sharedP, *sharedQ;
+
+static void *crossCopier(void *arg)
+{
+    // One thread copies P <- Q, the other Q <- P.
+    bool forward = (arg != NULL);
+    Quad *dest = forward ? sharedP : sharedQ;
+    Quad *src = forward ? sharedQ : sharedP;
+    for (int i = 0; i < ROUNDS; i++) {
+        objc_copyStruct(dest, src, sizeof(Quad), YES, NO);
+        Quad q;
+        objc_copyStruct(&q, dest, sizeof(Quad), YES, NO);
+        testassert(q.a == q.b  &&  q.b == q.c  &&  q.c == q.d);
+    }
+    return NULL;
+}
+
+int main()
+{
+    holder = [Holder new];
+
+    pthread_t threads[READERS];
+    for (int t = 0; t < READERS; t++) {
+        pthread_create(&threads[t], NULL, &reader, NULL);
+    }
+
+    for (long i = 0; i < ROUNDS; i++) {
+        Value *v = [Value new];
+        v->canary = 42;
+        holder.value = v;
+        [v release];
+        holder.quad = (Quad){ i, i, i, i };
+    }
+
+    done = true;
+    for (int t = 0; t < READERS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    testassert(deallocs == ROUNDS - 1);
+
+    holder.value = nil;
+    testassert(deallocs == ROUNDS);
+
+    [holder release];
+
+    // Heap to heap in both directions at once, while another thread 
+    // keeps rewriting one side.
+    sharedP = (Quad *)calloc(1, sizeof(Quad));
+    sharedQ = (Quad *)calloc(1, sizeof(Quad));
+    pthread_t forward, backward;
+    pthread_create(&forward, NULL, &crossCopier, (void *)1);
+    pthread_create(&backward, NULL, &crossCopier, NULL);
+    for (long i = 0; i < ROUNDS; i++) {
+        Quad q = { i, i, i, i };
+        objc_copyStruct(sharedQ, &q, sizeof(Quad), YES, NO);
+    }
+    pthread_join(forward, NULL);
+    pthread_join(backward, NULL);
+    free(sharedP);
+    free(sharedQ);
+
+    succeed(__FILE__);
+}
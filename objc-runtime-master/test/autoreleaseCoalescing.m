@@ -0,0 +1,54 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+
+// Consecutive autoreleases of one object share a pool entry.
+// Popping the pool must still release the object once per autorelease.
+
+#define COUNT 200000
+
+int main()
+{
+    TestRoot *a = [TestRoot new];
+    TestRoot *b = [TestRoot new];
+
+    // More repeats than one entry can count.
+    void *pool = objc_autoreleasePoolPush();
+    for (int i = 0; i < COUNT; i++) {
+        [[a retain] autorelease];
+    }
+    testassert([a retainCount] == COUNT + 1);
+    TestRootRelease = 0;
+    objc_autoreleasePoolPop(pool);
+    testassert(TestRootRelease == COUNT);
+    testassert([a retainCount] == 1);
+
+    // Interleaved objects and nested pools.
+    TestRootRelease = 0;
+    pool = objc_autoreleasePoolPush();
+    [[a retain] autorelease];
+    [[a retain] autorelease];
+    [[b retain] autorelease];
+    [[a retain] autorelease];
+    void *inner = objc_autoreleasePoolPush();
+    [[a retain] autorelease];
+    [[a retain] autorelease];
+    objc_autoreleasePoolPop(inner);
+    testassert(TestRootRelease == 2);
+    testassert([a retainCount] == 4);
+    objc_autoreleasePoolPop(pool);
+    testassert(TestRootRelease == 6);
+    testassert([a retainCount] == 1);
+    testassert([b retainCount] == 1);
+
+    TestRootDealloc = 0;
+    pool = objc_autoreleasePoolPush();
+    [a autorelease];
+    [b autorelease];
+    objc_autoreleasePoolPop(pool);
+    testassert(TestRootDealloc == 2);
+
+    succeed(__FILE__);
+}
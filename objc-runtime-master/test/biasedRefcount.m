@@ -0,0 +1,113 @@
+/*
+TEST_CONFIG MEM=mrc
+TEST_ENV OBJC_ENABLE_BIASED_REFCOUNT=YES
+*/
+
+#include "test.h"
+#include "testroot.i"
+#include <pthread.h>
+#include <objc/objc-internal.h>
+
+// With biased reference counting the allocating thread counts its own
+// references privately. Releases from other threads must still be
+// honored, and the object must die exactly once.
+
+#define HANDOFFS 1000
+
+static void *releaser(void *arg)
+{
+    [(id)arg release];
+    return NULL;
+}
+
+static void *retainer(void *arg)
+{
+    id obj = (id)arg;
+    for (int i = 0; i < 100; i++) [obj retain];
+    for (int i = 0; i < 100; i++) [obj release];
+    return NULL;
+}
+
+static void *allocator(void *arg __unused)
+{
+    // Exits still holding a reference. The thread exit hands it over.
+    return [TestRoot new];
+}
+
+static void *disposer(void *arg)
+{
+    // Frees the owner's object without releasing it, 
+    // then likely allocates a new object at the same address.
+    object_dispose((id)arg);
+    return [TestRoot new];
+}
+
+int main()
+{
+    // Owner-only retains and releases.
+    TestRootDealloc = 0;
+    TestRoot *obj = [TestRoot new];
+    [obj retain];
+    [obj retain];
+    testassert([obj retainCount] == 3);
+    [obj release];
+    [obj release];
+    testassert(TestRootDealloc == 0);
+    [obj release];
+    testassert(TestRootDealloc == 1);
+
+    // Other threads retain and release the shared count.
+    obj = [TestRoot new];
+    pthread_t th;
+    pthread_create(&th, NULL, &retainer, obj);
+    pthread_join(th, NULL);
+    testassert(TestRootDealloc == 1);
+    [obj release];
+    testassert(TestRootDealloc == 2);
+
+    // The last release happens on another thread. The owner
+    // finishes it at its next pool pop.
+    TestRootDealloc = 0;
+    for (int i = 0; i < HANDOFFS; i++) {
+        void *pool = objc_autoreleasePoolPush();
+        obj = [TestRoot new];
+        [obj retain];
+        pthread_create(&th, NULL, &releaser, obj);
+        [obj release];
+        pthread_join(th, NULL);
+        objc_autoreleasePoolPop(pool);
+        testassert(TestRootDealloc == i + 1);
+    }
+
+    // An object adopted by a thread that exits.
+    void *result;
+    pthread_create(&th, NULL, &allocator, NULL);
+    pthread_join(th, &result);
+    obj = (TestRoot *)result;
+    testassert([obj retainCount] == 1);
+    TestRootDealloc = 0;
+    [obj release];
+    testassert(TestRootDealloc == 1);
+
+    // An adopted object freed by object_dispose() on another thread. 
+    // The owner must forget it, and must not count or release a new 
+    // object at the same address.
+    for (int i = 0; i < HANDOFFS; i++) {
+        void *pool = objc_autoreleasePoolPush();
+        obj = [TestRoot new];
+        pthread_create(&th, NULL, &disposer, obj);
+        pthread_join(th, &result);
+        TestRoot *other = (TestRoot *)result;
+        TestRootDealloc = 0;
+        [other retain];
+        testassert([other retainCount] == 2);
+        [other release];
+        objc_autoreleasePoolPop(pool);
+        testassert(TestRootDealloc == 0);
+        testassert([other retainCount] == 1);
+        [other release];
+        testassert(TestRootDealloc == 1);
+    }
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,73 @@
+/*
+TEST_CONFIG MEM=mrc
+TEST_ENV MallocScribble=1
+*/
+
+#include "test.h"
+#include "testroot.i"
+#include <pthread.h>
+#include <objc/runtime.h>
+#include <objc/message.h>
+
+// objc_msgSend probes a method cache while other threads grow it
+// and flush it. Retired buckets must not be freed while a probe
+// may still be reading them. With MallocScribble a freed bucket
+// array is overwritten, so a probe of one crashes or calls the
+// wrong method.
+
+#define THREADS 4
+#define SELECTORS 512
+#define FLUSHES 20000
+
+static SEL sels[SELECTORS];
+static Class cls;
+static volatile bool done;
+
+static SEL identity(id self __unused, SEL _cmd)
+{
+    return _cmd;
+}
+
+static void *messenger(void *arg)
+{
+    id obj = (id)arg;
+    unsigned i = 0;
+    while (!done) {
+        // Walking many selectors keeps the cache growing.
+        SEL sel = sels[i++ % SELECTORS];
+        testassert(((SEL(*)(id, SEL))objc_msgSend)(obj, sel) == sel);
+    }
+    return NULL;
+}
+
+int main()
+{
+    char name[32];
+    cls = objc_allocateClassPair([TestRoot class], "Raced", 0);
+    for (int i = 0; i < SELECTORS; i++) {
+        snprintf(name, sizeof(name), "raced%d", i);
+        sels[i] = sel_registerName(name);
+        class_addMethod(cls, sels[i], (IMP)identity, ":@:");
+    }
+    objc_registerClassPair(cls);
+    id obj = [cls new];
+
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &messenger, obj);
+    }
+
+    // Each flush retires the current buckets while the
+    // messengers are busy refilling and growing them.
+    for (int i = 0; i < FLUSHES; i++) {
+        _objc_flush_caches(cls);
+    }
+
+    done = true;
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    [obj release];
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,109 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+
+@interface Recorded : TestRoot @end
+@implementation Recorded
+-(void)hot1 { }
+-(void)hot2 { }
++(void)classHot { }
+@end
+
+@interface Preloaded : TestRoot @end
+@implementation Preloaded
+-(void)hot1 { }
+-(void)hot2 { }
++(void)classHot { }
+@end
+
+static bool cacheContains(Class cls, SEL sel);
+
+// DeferredSub's +initialize runs inside DeferredSuper's, so it is 
+// only marked initialized once DeferredSuper's +initialize returns.
+@interface DeferredSuper : TestRoot @end
+@interface DeferredSub : DeferredSuper @end
+
+@implementation DeferredSuper
++(void)initialize {
+    if (self == [DeferredSuper class]) {
+        [DeferredSub class];
+        testassert(!cacheContains([DeferredSub class], @selector(hot1)));
+    }
+}
+@end
+
+@implementation DeferredSub
+-(void)hot1 { }
+@end
+
+static bool cacheContains(Class cls, SEL sel)
+{
+    int count;
+    objc_imp_cache_entry *entries = class_copyImpCache(cls, &count);
+    bool found = false;
+    for (int i = 0; i < count; i++) {
+        if (entries[i].sel == sel) found = true;
+    }
+    free(entries);
+    return found;
+}
+
+int main()
+{
+    char path[] = "/tmp/objc-cache-profile-XXXXXX";
+    int fd = mkstemp(path);
+    testassert(fd >= 0);
+    close(fd);
+
+    Recorded *obj = [Recorded new];
+    [obj hot1];
+    [obj hot2];
+    [Recorded classHot];
+    [obj release];
+
+    testassert(objc_cache_writeProfile(path));
+
+    // Rewrite the profile so it names Preloaded instead, as if
+    // the profile had been recorded by an earlier process.
+    FILE *in = fopen(path, "r");
+    testassert(in);
+    char buf[4096];
+    size_t len = fread(buf, 1, sizeof(buf) - 1, in);
+    fclose(in);
+    buf[len] = 0;
+    testassert(strstr(buf, "-Recorded "));
+    testassert(strstr(buf, "+Recorded "));
+    testassert(strstr(buf, " hot1"));
+
+    FILE *out = fopen(path, "w");
+    testassert(out);
+    fprintf(out, "-Preloaded hot1 hot2 notAMethod\n");
+    fprintf(out, "+Preloaded classHot\n");
+    fprintf(out, "-NoSuchClassInThisProcess hot1\n");
+    fprintf(out, "-DeferredSub hot1\n");
+    fclose(out);
+
+    testassert(objc_cache_loadProfile(path) == 5);
+    unlink(path);
+
+    Class cls = objc_getClass("Preloaded");
+    testassert(!cacheContains(cls, @selector(hot1)));
+
+    // +initialize fills both caches from the profile.
+    [Preloaded class];
+    testassert(cacheContains(cls, @selector(hot1)));
+    testassert(cacheContains(cls, @selector(hot2)));
+    testassert(cacheContains(object_getClass(cls), @selector(classHot)));
+    // Missing methods are not cached as forwarded.
+    testassert(!cacheContains(cls, sel_registerName("notAMethod")));
+
+    // A subclass initialized from inside its superclass's +initialize 
+    // is filled once the superclass finishes.
+    [DeferredSuper class];
+    testassert(cacheContains([DeferredSub class], @selector(hot1)));
+
+    succeed(__FILE__);
+}
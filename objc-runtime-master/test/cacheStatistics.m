@@ -0,0 +1,77 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+
+static void noopIMP(id self __unused, SEL _cmd __unused) {}
+
+static const objc_cache_class_statistics *
+findClass(const objc_cache_class_statistics *stats, unsigned count, Class cls)
+{
+    for (unsigned i = 0; i < count; i++) {
+        if (stats[i].cls == cls) return &stats[i];
+    }
+    return NULL;
+}
+
+int main()
+{
+    int methodCount = 64;
+
+    Class c = objc_allocateClassPair([TestRoot class], "CacheStats", 0);
+    SEL *sels = malloc(methodCount * sizeof(*sels));
+    for (int i = 0; i < methodCount; i++) {
+        char *name;
+        asprintf(&name, "cacheStatsSelector%d", i);
+        sels[i] = sel_registerName(name);
+        free(name);
+        class_addMethod(c, sels[i], (IMP)noopIMP, "v@:");
+    }
+    objc_registerClassPair(c);
+
+    id obj = [c new];
+    for (int i = 0; i < methodCount; i++) {
+        ((void (*)(id, SEL))objc_msgSend)(obj, sels[i]);
+    }
+
+    objc_cache_statistics totals;
+    unsigned count;
+    objc_cache_class_statistics *stats =
+        objc_cache_copyStatistics(&totals, &count);
+    testassert(stats);
+    testassert(count > 0);
+
+    const objc_cache_class_statistics *cs = findClass(stats, count, c);
+    testassert(cs);
+    testassert(cs->misses >= (unsigned long)methodCount);
+    testassert(cs->reallocations > 1);
+    testassert(cs->capacity >= (unsigned)methodCount);
+    // Growing the cache keeps the entries already in it.
+    testassert(cs->occupied >= (unsigned)methodCount);
+    testassert(totals.reallocations >= cs->reallocations);
+
+    unsigned long fills = 0;
+    for (int i = 0; i < OBJC_CACHE_PROBE_HISTOGRAM_COUNT; i++) {
+        fills += totals.probeLengths[i];
+    }
+    testassert(fills >= (unsigned long)methodCount);
+
+    // Repeated sends hit the cache and add no misses.
+    unsigned long misses = cs->misses;
+    free(stats);
+    for (int i = 0; i < methodCount; i++) {
+        ((void (*)(id, SEL))objc_msgSend)(obj, sels[i]);
+    }
+    stats = objc_cache_copyStatistics(NULL, &count);
+    cs = findClass(stats, count, c);
+    testassert(cs);
+    testassert(cs->misses == misses);
+    free(stats);
+
+    [obj release];
+    free(sels);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,123 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <pthread.h>
+#include <stdio.h>
+#include <objc/runtime.h>
+
+// Realized classes are found by name without runtimeLock.
+// Lookups racing class registration and disposal must return either
+// nil or the right class, and must see changes once they are made.
+
+#define THREADS 4
+#define STABLE 2000
+#define CHURN 2000
+
+@interface Unrealized : TestRoot @end
+@implementation Unrealized @end
+
+static Class stable[STABLE];
+static volatile bool done;
+static volatile Class registered;
+
+static void *waiter(void *arg __unused)
+{
+    // Once objc_registerClassPair() returns, every lookup finds the class.
+    while (!registered) {
+        Class cls = objc_getClass("Registered");
+        if (cls) testassert(cls == registered  ||  !registered);
+    }
+    for (int i = 0; i < 1000; i++) {
+        testassert(objc_getClass("Registered") == registered);
+        testassert(objc_lookUpClass("Registered") == registered);
+    }
+    return NULL;
+}
+
+static void *reader(void *arg __unused)
+{
+    char name[64];
+    while (!done) {
+        for (int i = 0; i < STABLE; i++) {
+            snprintf(name, sizeof(name), "Stable%d", i);
+            testassert(objc_getClass(name) == stable[i]);
+        }
+        for (int i = 0; i < CHURN; i++) {
+            snprintf(name, sizeof(name), "Churn%d", i);
+            Class cls = objc_getClass(name);
+            if (cls) testassert(0 == strcmp(class_getName(cls), name));
+        }
+    }
+    return NULL;
+}
+
+int main()
+{
+    char name[64];
+
+    // Found by the locked path first, then without the lock.
+    Class cls = objc_getClass("Unrealized");
+    testassert(cls == [Unrealized class]);
+    testassert(objc_getClass("Unrealized") == cls);
+    testassert(objc_getClass("NoSuchClass") == nil);
+
+    for (int i = 0; i < STABLE; i++) {
+        snprintf(name, sizeof(name), "Stable%d", i);
+        stable[i] = objc_allocateClassPair([TestRoot class], name, 0);
+        // Not registered yet.
+        testassert(objc_getClass(name) == nil);
+        objc_registerClassPair(stable[i]);
+        testassert(objc_getClass(name) == stable[i]);
+    }
+
+    pthread_t threads[THREADS];
+
+    // Dynamically registered classes are published for lock-free 
+    // lookup when objc_registerClassPair() finishes constructing them.
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &waiter, NULL);
+    }
+    cls = objc_allocateClassPair([TestRoot class], "Registered", 0);
+    testassert(objc_getClass("Registered") == nil);
+    objc_registerClassPair(cls);
+    registered = cls;
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    // So are subclasses of them, and duplicated classes.
+    Class sub = objc_allocateClassPair(cls, "RegisteredSub", 0);
+    objc_registerClassPair(sub);
+    testassert(objc_getClass("RegisteredSub") == sub);
+    testassert(objc_getClass("RegisteredSub") == sub);
+    Class dup = objc_duplicateClass(cls, "RegisteredDup", 0);
+    testassert(objc_getClass("RegisteredDup") == dup);
+    testassert(objc_getClass("RegisteredDup") == dup);
+
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &reader, NULL);
+    }
+
+    for (int round = 0; round < 4; round++) {
+        Class churn[CHURN];
+        for (int i = 0; i < CHURN; i++) {
+            snprintf(name, sizeof(name), "Churn%d", i);
+            churn[i] = objc_allocateClassPair([TestRoot class], name, 0);
+            objc_registerClassPair(churn[i]);
+            testassert(objc_getClass(name) == churn[i]);
+        }
+        for (int i = 0; i < CHURN; i++) {
+            snprintf(name, sizeof(name), "Churn%d", i);
+            objc_disposeClassPair(churn[i]);
+            testassert(objc_getClass(name) == nil);
+        }
+    }
+
+    done = true;
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    succeed(__FILE__);
+}
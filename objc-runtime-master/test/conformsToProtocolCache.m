@@ -0,0 +1,85 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <pthread.h>
+#include <objc/runtime.h>
+
+// class_conformsToProtocol remembers its answers, yes and no.
+// Anything that changes an answer must be seen by the next call.
+
+@protocol Inherited @end
+@protocol Adopted <Inherited> @end
+@protocol Unadopted @end
+
+@interface Conforming : TestRoot <Adopted> @end
+@implementation Conforming @end
+
+#define THREADS 4
+#define CLASSES 200
+
+static volatile bool done;
+
+static void *reader(void *arg __unused)
+{
+    Class cls = [Conforming class];
+    while (!done) {
+        testassert(class_conformsToProtocol(cls, @protocol(Adopted)));
+        testassert(class_conformsToProtocol(cls, @protocol(Inherited)));
+        testassert(!class_conformsToProtocol(cls, @protocol(Unadopted)));
+    }
+    return NULL;
+}
+
+int main()
+{
+    Class cls = [Conforming class];
+
+    // Asked twice, so the second answer comes from the cache.
+    for (int i = 0; i < 2; i++) {
+        testassert(class_conformsToProtocol(cls, @protocol(Adopted)));
+        testassert(class_conformsToProtocol(cls, @protocol(Inherited)));
+        testassert(!class_conformsToProtocol(cls, @protocol(Unadopted)));
+        testassert(!class_conformsToProtocol([TestRoot class], @protocol(Adopted)));
+    }
+
+    // class_addProtocol
+    testassert(class_addProtocol([TestRoot class], @protocol(Unadopted)));
+    testassert(class_conformsToProtocol([TestRoot class], @protocol(Unadopted)));
+    testassert(!class_addProtocol([TestRoot class], @protocol(Unadopted)));
+
+    // protocol_addProtocol on a protocol a class already adopted
+    Protocol *building = objc_allocateProtocol("Building");
+    Class adopter = objc_allocateClassPair([TestRoot class], "Adopter", 0);
+    class_addProtocol(adopter, building);
+    objc_registerClassPair(adopter);
+    testassert(class_conformsToProtocol(adopter, building));
+    testassert(!class_conformsToProtocol(adopter, @protocol(Inherited)));
+    protocol_addProtocol(building, @protocol(Inherited));
+    testassert(class_conformsToProtocol(adopter, @protocol(Inherited)));
+    objc_registerProtocol(building);
+    testassert(class_conformsToProtocol(adopter, building));
+
+    // A disposed class's answers don't leak to classes made later,
+    // even at the same address.
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &reader, NULL);
+    }
+    for (int i = 0; i < CLASSES; i++) {
+        Class c = objc_allocateClassPair([TestRoot class], "Churn", 0);
+        if (i % 2) class_addProtocol(c, @protocol(Unadopted));
+        objc_registerClassPair(c);
+        testassert(class_conformsToProtocol(c, @protocol(Unadopted)) ==
+                   (i % 2 ? YES : NO));
+        testassert(class_conformsToProtocol(c, @protocol(Unadopted)) ==
+                   (i % 2 ? YES : NO));
+        objc_disposeClassPair(c);
+    }
+    done = true;
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    succeed(__FILE__);
+}
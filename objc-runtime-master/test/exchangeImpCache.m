@@ -0,0 +1,75 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+
+@interface Swizzled : TestRoot @end
+@implementation Swizzled
+-(int)one { return 1; }
+-(int)two { return 2; }
+-(int)untouched { return 3; }
+@end
+
+@interface SwizzledSub : Swizzled @end
+@implementation SwizzledSub @end
+
+@interface Bystander : TestRoot @end
+@implementation Bystander
+-(int)bystander { return 4; }
+@end
+
+static bool cacheContains(Class cls, SEL sel)
+{
+    int count;
+    objc_imp_cache_entry *entries = class_copyImpCache(cls, &count);
+    bool found = false;
+    for (int i = 0; i < count; i++) {
+        if (entries[i].sel == sel) found = true;
+    }
+    free(entries);
+    return found;
+}
+
+int main()
+{
+    Swizzled *obj = [SwizzledSub new];
+    Bystander *other = [Bystander new];
+
+    testassert([obj one] == 1);
+    testassert([obj two] == 2);
+    testassert([obj untouched] == 3);
+    testassert([other bystander] == 4);
+
+    Class sub = [SwizzledSub class];
+    testassert(cacheContains(sub, @selector(one)));
+    testassert(cacheContains(sub, @selector(untouched)));
+    testassert(cacheContains([Bystander class], @selector(bystander)));
+
+    method_exchangeImplementations
+        (class_getInstanceMethod([Swizzled class], @selector(one)),
+         class_getInstanceMethod([Swizzled class], @selector(two)));
+
+    // Only the exchanged selectors leave the caches.
+    testassert(!cacheContains(sub, @selector(one)));
+    testassert(!cacheContains(sub, @selector(two)));
+    testassert(cacheContains(sub, @selector(untouched)));
+    testassert(cacheContains([Bystander class], @selector(bystander)));
+
+    testassert([obj one] == 2);
+    testassert([obj two] == 1);
+    testassert([obj untouched] == 3);
+
+    method_setImplementation
+        (class_getInstanceMethod([Swizzled class], @selector(untouched)),
+         class_getMethodImplementation([Bystander class], @selector(bystander)));
+    testassert(!cacheContains(sub, @selector(untouched)));
+    testassert(cacheContains(sub, @selector(one)));
+    testassert([obj untouched] == 4);
+
+    [obj release];
+    [other release];
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,75 @@
+// TEST_CONFIG
+
+#include "test.h"
+#include "testroot.i"
+
+// Names that match no class are remembered, so repeated lookups
+// skip the getClass hooks until something could change the answer.
+
+objc_hook_getClass PreviousHook;
+static int HookCalls;
+static bool HookProvides;
+BOOL GetClassHook(const char *name, Class *outClass)
+{
+    HookCalls++;
+    if (HookProvides  &&  0 == strcmp(name, "HookedClass")) {
+        Class cls = objc_allocateClassPair([TestRoot class], "HookedClass", 0);
+        objc_registerClassPair(cls);
+        *outClass = cls;
+        return YES;
+    }
+    return PreviousHook(name, outClass);
+}
+
+int main()
+{
+    objc_setHook_getClass(GetClassHook, &PreviousHook);
+
+    // Only the first lookup asks the hook.
+    HookCalls = 0;
+    for (int i = 0; i < 100; i++) {
+        testassert(!objc_getClass("MissingClass"));
+        testassert(!objc_lookUpClass("MissingClass"));
+    }
+    testassert(HookCalls == 1);
+
+    // A new class invalidates the cache, whatever its name.
+    Class other = objc_allocateClassPair([TestRoot class], "OtherClass", 0);
+    objc_registerClassPair(other);
+    HookCalls = 0;
+    testassert(!objc_getClass("MissingClass"));
+    testassert(!objc_getClass("MissingClass"));
+    testassert(HookCalls == 1);
+
+    // A class with the missing name is found.
+    Class cls = objc_allocateClassPair([TestRoot class], "MissingClass", 0);
+    objc_registerClassPair(cls);
+    testassert(objc_getClass("MissingClass") == cls);
+
+    // A missing name answered later by a hook is found.
+    HookCalls = 0;
+    testassert(!objc_getClass("HookedClass"));
+    testassert(!objc_getClass("HookedClass"));
+    testassert(HookCalls == 1);
+    HookProvides = true;
+    testassert(!objc_getClass("HookedClass"));
+    objc_hook_getClass unused;
+    objc_setHook_getClass(PreviousHook, &unused);
+    objc_setHook_getClass(GetClassHook, &unused);
+    Class hooked = objc_getClass("HookedClass");
+    testassert(hooked);
+    testassert(0 == strcmp(class_getName(hooked), "HookedClass"));
+    testassert(objc_getClass("HookedClass") == hooked);
+
+    // Many missing names don't grow the cache without bound
+    // or evict the answers of real classes.
+    char name[64];
+    for (int i = 0; i < 10000; i++) {
+        snprintf(name, sizeof(name), "MissingClass%d", i);
+        testassert(!objc_getClass(name));
+    }
+    testassert(objc_getClass("MissingClass") == cls);
+    testassert(objc_getClass("TestRoot") == [TestRoot class]);
+
+    succeed(__FILE__);
+}
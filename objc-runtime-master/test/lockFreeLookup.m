@@ -0,0 +1,83 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <pthread.h>
+#include <objc/runtime.h>
+
+// Method lookup on initialized classes skips runtimeLock. Readers must
+// only ever see an IMP that some method actually had, while another
+// thread adds methods and swaps implementations.
+
+#define READERS 4
+#define WRITES 2000
+
+@interface LockFreeSuper : TestRoot @end
+@implementation LockFreeSuper
+-(int)inherited { return 1; }
+@end
+
+@interface LockFreeSub : LockFreeSuper @end
+@implementation LockFreeSub
+-(int)swapped { return 2; }
+@end
+
+static int implA(id self __unused, SEL _cmd __unused) { return 3; }
+static int implB(id self __unused, SEL _cmd __unused) { return 4; }
+static int added(id self __unused, SEL _cmd __unused) { return 5; }
+
+static volatile bool done;
+static IMP inheritedIMP;
+static IMP swappedIMP;
+
+static void *reader(void *arg __unused)
+{
+    Class cls = [LockFreeSub class];
+    while (!done) {
+        IMP imp = class_getMethodImplementation(cls, @selector(swapped));
+        testassert(imp == swappedIMP  ||  imp == (IMP)implA  ||
+                   imp == (IMP)implB);
+        imp = class_getMethodImplementation(cls, @selector(inherited));
+        testassert(imp == inheritedIMP);
+    }
+    return NULL;
+}
+
+int main()
+{
+    Class cls = [LockFreeSub class];
+    inheritedIMP = class_getMethodImplementation(cls, @selector(inherited));
+    swappedIMP = class_getMethodImplementation(cls, @selector(swapped));
+    Method m = class_getInstanceMethod(cls, @selector(swapped));
+
+    pthread_t threads[READERS];
+    for (int t = 0; t < READERS; t++) {
+        pthread_create(&threads[t], NULL, &reader, NULL);
+    }
+
+    for (int i = 0; i < WRITES; i++) {
+        char *name;
+        asprintf(&name, "lockFreeAdded%d", i);
+        class_addMethod(cls, sel_registerName(name), (IMP)added, "i@:");
+        free(name);
+        method_setImplementation(m, (i & 1) ? (IMP)implA : (IMP)implB);
+    }
+
+    done = true;
+    for (int t = 0; t < READERS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    // The last write wins once the writers are done.
+    testassert(class_getMethodImplementation(cls, @selector(swapped)) ==
+               (IMP)implA);
+    testassert(class_getMethodImplementation
+               (cls, sel_registerName("lockFreeAdded0")) == (IMP)added);
+
+    LockFreeSub *obj = [LockFreeSub new];
+    testassert([obj swapped] == 3);
+    testassert([obj inherited] == 1);
+    [obj release];
+
+    succeed(__FILE__);
+}
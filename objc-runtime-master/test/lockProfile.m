@@ -0,0 +1,63 @@
+/*
+TEST_CONFIG MEM=mrc
+TEST_ENV OBJC_PROFILE_LOCKS=YES
+
+TEST_RUN_OUTPUT
+objc\[\d+\]: LOCK PROFILE: ##############
+objc\[\d+\]: LOCK PROFILE: runtime locks
+(objc\[\d+\]: LOCK PROFILE: .*\n)*objc\[\d+\]: LOCK PROFILE: +\d+ acquired +\d+ contended +\d+ ns waited +\d+ ns max hold  runtimeLock
+(objc\[\d+\]: LOCK PROFILE: .*\n)*objc\[\d+\]: LOCK PROFILE: @synchronized, by class of the synchronized object
+(objc\[\d+\]: LOCK PROFILE: .*\n)*objc\[\d+\]: LOCK PROFILE: +\d+ acquired +\d+ contended +\d+ ns waited +\d+ ns max hold  SharedLock
+(objc\[\d+\]: LOCK PROFILE: .*\n)*OK: lockProfile.m
+END
+*/
+
+#include "test.h"
+#include "testroot.i"
+#include <pthread.h>
+#include <objc/runtime.h>
+#include <objc/objc-sync.h>
+#include <objc/objc-internal.h>
+
+// OBJC_PROFILE_LOCKS records runtime locks and attributes
+// @synchronized contention to the synchronized object's class.
+
+#define THREADS 8
+#define COUNT 10000
+
+@interface SharedLock : TestRoot @end
+@implementation SharedLock @end
+
+static id shared;
+static int counter;
+
+static void *threadfn(void *arg __unused)
+{
+    for (int i = 0; i < COUNT; i++) {
+        testassert(objc_sync_enter(shared) == OBJC_SYNC_SUCCESS);
+        counter++;
+        testassert(objc_sync_exit(shared) == OBJC_SYNC_SUCCESS);
+    }
+    return NULL;
+}
+
+int main()
+{
+    shared = [SharedLock new];
+
+    // runtimeLock
+    objc_allocateClassPair([TestRoot class], "Dynamic", 0);
+
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &threadfn, NULL);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    testassert(counter == THREADS * COUNT);
+
+    _objc_lockProfilePrint();
+
+    succeed(__FILE__);
+}
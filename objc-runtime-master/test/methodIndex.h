@@ -0,0 +1,10 @@
+#include <objc/objc.h>
+#include "test.h"
+
+@interface Indexed : TestRoot @end
+
+@interface Indexed (Methods)
+-(int)base;
+-(int)overridden;
+-(int)late;
+@end
@@ -0,0 +1,74 @@
+/*
+TEST_BUILD
+    $C{COMPILE} $DIR/methodIndex0.m -o methodIndex0.dylib -dynamiclib
+    $C{COMPILE} $DIR/methodIndex2.m -x none methodIndex0.dylib -o methodIndex2.dylib -dynamiclib
+    $C{COMPILE} $DIR/methodIndex.m  -x none methodIndex0.dylib -o methodIndex.exe
+END
+*/
+
+#include "test.h"
+#include <objc/runtime.h>
+#include <objc/message.h>
+#include <dlfcn.h>
+
+#include "methodIndex.h"
+
+// Classes with many method lists are searched through a hashed index.
+// The index must find what searching the lists in order would,
+// and must follow every change to the lists after it is built.
+
+static int call(id obj, const char *name)
+{
+    return ((int(*)(id, SEL))objc_msgSend)(obj, sel_registerName(name));
+}
+
+static int added(id self __unused, SEL _cmd __unused) { return 7; }
+static int replaced(id self __unused, SEL _cmd __unused) { return 4; }
+static int setImp(id self __unused, SEL _cmd __unused) { return 5; }
+
+int main()
+{
+    Class cls = [Indexed class];
+    Indexed *obj = [Indexed new];
+
+    // The category's override wins over the base method.
+    testassert([obj base] == 1);
+    testassert([obj overridden] == 3);
+    char name[16];
+    for (int i = 0; i < 8; i++) {
+        snprintf(name, sizeof(name), "cat%d", i);
+        testassert(call(obj, name) == i);
+    }
+    Method m = class_getInstanceMethod(cls, @selector(overridden));
+    testassert(((int(*)(id, SEL))method_getImplementation(m))(obj, @selector(overridden)) == 3);
+
+    // class_addMethod after the index is built.
+    testassert(class_addMethod(cls, sel_registerName("added"), (IMP)added, "i@:"));
+    testassert(call(obj, "added") == 7);
+    testassert([obj overridden] == 3);
+    testassert(call(obj, "cat5") == 5);
+
+    // class_replaceMethod replaces the winning method.
+    class_replaceMethod(cls, @selector(overridden), (IMP)replaced, "i@:");
+    testassert([obj overridden] == 4);
+    testassert([obj base] == 1);
+
+    // method_setImplementation on a base method.
+    method_setImplementation(class_getInstanceMethod(cls, @selector(base)),
+                             (IMP)setImp);
+    testassert([obj base] == 5);
+    testassert([obj overridden] == 4);
+
+    // A category attached after the index is built wins over all of them.
+    testassert(dlopen("methodIndex2.dylib", RTLD_LAZY));
+    testassert([obj overridden] == 2);
+    testassert([obj late] == 2);
+    testassert([obj base] == 5);
+    testassert(call(obj, "added") == 7);
+    for (int i = 0; i < 8; i++) {
+        snprintf(name, sizeof(name), "cat%d", i);
+        testassert(call(obj, name) == i);
+    }
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,43 @@
+#include "methodIndex.h"
+#include "testroot.i"
+
+@implementation Indexed
+-(int)base { return 1; }
+-(int)overridden { return 1; }
+@end
+
+// Enough categories to give Indexed an indexed method list array.
+// Category3 overrides a base method.
+
+@implementation Indexed (Category0)
+-(int)cat0 { return 0; }
+@end
+
+@implementation Indexed (Category1)
+-(int)cat1 { return 1; }
+@end
+
+@implementation Indexed (Category2)
+-(int)cat2 { return 2; }
+@end
+
+@implementation Indexed (Category3)
+-(int)cat3 { return 3; }
+-(int)overridden { return 3; }
+@end
+
+@implementation Indexed (Category4)
+-(int)cat4 { return 4; }
+@end
+
+@implementation Indexed (Category5)
+-(int)cat5 { return 5; }
+@end
+
+@implementation Indexed (Category6)
+-(int)cat6 { return 6; }
+@end
+
+@implementation Indexed (Category7)
+-(int)cat7 { return 7; }
+@end
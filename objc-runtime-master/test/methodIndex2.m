@@ -0,0 +1,6 @@
+#include "methodIndex.h"
+
+@implementation Indexed (Late)
+-(int)overridden { return 2; }
+-(int)late { return 2; }
+@end
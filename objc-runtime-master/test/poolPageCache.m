@@ -0,0 +1,64 @@
+/*
+TEST_CONFIG MEM=mrc
+TEST_ENV OBJC_POOL_PAGE_SIZE=16384
+*/
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+
+// Pool pages use the configured size, and pages emptied by a pop are
+// kept for the next growth instead of being freed.
+
+#define COUNT 10000
+
+static id objs[COUNT];
+
+static void fill(void)
+{
+    for (int i = 0; i < COUNT; i++) {
+        [[objs[i] retain] autorelease];
+    }
+}
+
+int main()
+{
+    objc_autoreleasepool_statistics stats;
+
+    for (int i = 0; i < COUNT; i++) objs[i] = [TestRoot new];
+
+    objc_autoreleasePoolGetStatistics(&stats);
+    testassert(stats.pageSize == 16384);
+
+    void *outer = objc_autoreleasePoolPush();
+    void *pool = objc_autoreleasePoolPush();
+    fill();
+    objc_autoreleasePoolGetStatistics(&stats);
+    unsigned grown = stats.pages;
+    testassert(grown >= COUNT * sizeof(id) / 16384);
+    testassert(stats.entries >= COUNT);
+    testassert(stats.cachedPages == 0);
+
+    objc_autoreleasePoolPop(pool);
+    objc_autoreleasePoolGetStatistics(&stats);
+    testassert(stats.pages == 1);
+    testassert(stats.cachedPages > 0);
+    testassert(stats.cachedPages < grown);
+    testassert(stats.hiwat >= COUNT);
+    unsigned cached = stats.cachedPages;
+
+    // Growing again takes the cached pages first.
+    pool = objc_autoreleasePoolPush();
+    fill();
+    objc_autoreleasePoolGetStatistics(&stats);
+    testassert(stats.pages == grown);
+    objc_autoreleasePoolPop(pool);
+    objc_autoreleasePoolGetStatistics(&stats);
+    testassert(stats.cachedPages == cached);
+
+    objc_autoreleasePoolPop(outer);
+
+    for (int i = 0; i < COUNT; i++) [objs[i] release];
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,68 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+
+// A resolver that declines a selector is not asked about it again
+// until some method list changes.
+
+static int instanceResolves;
+static int classResolves;
+static bool willResolve;
+
+static int resolvedIMP(id self __unused, SEL _cmd __unused) { return 7; }
+
+@interface Declines : TestRoot @end
+@implementation Declines
++(BOOL)resolveInstanceMethod:(SEL)sel {
+    instanceResolves++;
+    if (willResolve) {
+        class_addMethod(self, sel, (IMP)resolvedIMP, "i@:");
+        return YES;
+    }
+    return NO;
+}
++(BOOL)resolveClassMethod:(SEL)sel __unused {
+    classResolves++;
+    return NO;
+}
+@end
+
+@interface Unrelated : TestRoot @end
+@implementation Unrelated @end
+
+int main()
+{
+    Class cls = [Declines class];
+    SEL sel = sel_registerName("declinedSelector");
+
+    testassert(!class_respondsToSelector(cls, sel));
+    testassert(instanceResolves == 1);
+
+    // Flushing the cache loses the forwarding entry but not the miss.
+    _objc_flush_caches(cls);
+    testassert(!class_respondsToSelector(cls, sel));
+    testassert(instanceResolves == 1);
+
+    testassert(!class_respondsToSelector(object_getClass(cls), sel));
+    testassert(classResolves == 1);
+    _objc_flush_caches(object_getClass(cls));
+    testassert(!class_respondsToSelector(object_getClass(cls), sel));
+    testassert(classResolves == 1);
+
+    // Adding a method anywhere invalidates the remembered misses.
+    class_addMethod([Unrelated class], sel_registerName("unrelated"),
+                    (IMP)resolvedIMP, "i@:");
+    _objc_flush_caches(cls);
+    willResolve = true;
+    testassert(class_respondsToSelector(cls, sel));
+    testassert(instanceResolves == 2);
+
+    Declines *obj = [Declines new];
+    testassert(((int (*)(id, SEL))objc_msgSend)(obj, sel) == 7);
+    [obj release];
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,108 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <Foundation/NSObject.h>
+#include <objc/objc-internal.h>
+
+// objc_retainArray and objc_releaseArray behave like one objc_retain or
+// objc_release per element, including for objects with RR overrides 
+// and objects whose retain count has overflowed to the side table.
+
+#define COUNT 1000
+
+static int plainDeallocs;
+
+@interface Plain : NSObject @end
+@implementation Plain
+-(void)dealloc {
+    plainDeallocs++;
+    [super dealloc];
+}
+@end
+
+int main()
+{
+    id objs[COUNT];
+
+    // Objects with RR overrides still get their overrides called.
+    for (int i = 0; i < COUNT; i++) {
+        objs[i] = (i % 7 == 0) ? nil : [TestRoot new];
+    }
+    int live = 0;
+    for (int i = 0; i < COUNT; i++) if (objs[i]) live++;
+
+    TestRootRetain = 0;
+    TestRootRelease = 0;
+    TestRootDealloc = 0;
+    objc_retainArray(objs, COUNT);
+    testassert(TestRootRetain == live);
+    objc_releaseArray(objs, COUNT);
+    testassert(TestRootRelease == live);
+    testassert(TestRootDealloc == 0);
+    objc_releaseArray(objs, COUNT);
+    testassert(TestRootDealloc == live);
+
+    // Objects with default RR. Repeats of the same object count twice.
+    for (int i = 0; i < COUNT; i++) {
+        objs[i] = (i & 1) ? objs[i-1] : [Plain new];
+    }
+    objc_retainArray(objs, COUNT);
+    for (int i = 0; i < COUNT; i += 2) {
+        testassert([objs[i] retainCount] == 3);
+    }
+    objc_releaseArray(objs, COUNT);
+    testassert(plainDeallocs == 0);
+    id unique[COUNT/2];
+    for (int i = 0; i < COUNT/2; i++) {
+        unique[i] = objs[i*2];
+        testassert([unique[i] retainCount] == 1);
+    }
+    objc_releaseArray(unique, COUNT/2);
+    testassert(plainDeallocs == COUNT/2);
+
+    // Retain counts large enough to overflow the inline count into the 
+    // side table and to borrow back from it, in both directions.
+    enum { OBJECTS = 4, REPEAT = 1 << 20 };
+    id *many = (id *)malloc(OBJECTS * REPEAT * sizeof(id));
+    for (int i = 0; i < OBJECTS; i++) {
+        id obj = [Plain new];
+        for (int j = 0; j < REPEAT; j++) many[j * OBJECTS + i] = obj;
+    }
+    plainDeallocs = 0;
+    objc_retainArray(many, OBJECTS * REPEAT);
+    for (int i = 0; i < OBJECTS; i++) {
+        testassert([many[i] retainCount] == 1 + REPEAT);
+    }
+    objc_retainArray(many, OBJECTS * REPEAT);
+    for (int i = 0; i < OBJECTS; i++) {
+        testassert([many[i] retainCount] == 1 + 2*REPEAT);
+    }
+    objc_releaseArray(many, OBJECTS * REPEAT);
+    for (int i = 0; i < OBJECTS; i++) {
+        testassert([many[i] retainCount] == 1 + REPEAT);
+    }
+    objc_releaseArray(many, OBJECTS * REPEAT);
+    for (int i = 0; i < OBJECTS; i++) {
+        testassert([many[i] retainCount] == 1);
+    }
+    testassert(plainDeallocs == 0);
+    objc_releaseArray(many, OBJECTS);
+    testassert(plainDeallocs == OBJECTS);
+    free(many);
+
+#if OBJC_HAVE_TAGGED_POINTERS
+    // Tagged pointers are skipped.
+    id tagged[2] = {
+        (id)_objc_makeTaggedPointer(OBJC_TAG_7, 1),
+        (id)_objc_makeTaggedPointer(OBJC_TAG_7, 2),
+    };
+    objc_retainArray(tagged, 2);
+    objc_releaseArray(tagged, 2);
+#endif
+
+    objc_retainArray(objs, 0);
+    objc_releaseArray(objs, 0);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,59 @@
+// TEST_CONFIG
+
+#include "test.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <objc/runtime.h>
+
+// Selector lookups take no lock and new names are interned with CAS.
+// Threads racing to register the same new names, enough of them to
+// grow the table several times, must all get the same SEL for a name.
+
+#define THREADS 8
+#define NAMES 20000
+
+static SEL sels[THREADS][NAMES];
+
+static void *threadfn(void *arg)
+{
+    long t = (long)arg;
+    char buf[64];
+    for (int i = 0; i < NAMES; i++) {
+        // Half the threads walk the names backwards.
+        int n = (t & 1) ? NAMES - 1 - i : i;
+        snprintf(buf, sizeof(buf), "selConcurrent%d:", n);
+        SEL sel = sel_registerName(buf);
+        testassert(sel);
+        testassert(0 == strcmp(sel_getName(sel), buf));
+        testassert(sel_isMapped(sel));
+        sels[t][n] = sel;
+    }
+    return NULL;
+}
+
+int main()
+{
+    pthread_t threads[THREADS];
+    for (long t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &threadfn, (void *)t);
+    }
+    for (long t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    char buf[64];
+    for (int n = 0; n < NAMES; n++) {
+        for (int t = 1; t < THREADS; t++) {
+            testassert(sels[t][n] == sels[0][n]);
+        }
+        // The registered name is a copy, not the caller's buffer.
+        snprintf(buf, sizeof(buf), "selConcurrent%d:", n);
+        testassert(sel_registerName(buf) == sels[0][n]);
+        testassert(sel_getName(sels[0][n]) != buf);
+    }
+
+    // Names in the binary are already registered.
+    testassert(sel_registerName("alloc") == @selector(alloc));
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,80 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <objc/objc-internal.h>
+
+// SideTable contention benchmark.
+// Every thread stores and loads weak references to its own objects,
+// so any slowdown as threads are added comes from lock collisions
+// between unrelated objects that share a SideTable stripe.
+
+#if defined(__arm__)
+#define THREADS 16
+#define OBJECTS 64
+#define COUNT 1024*4
+#else
+#define THREADS 64
+#define OBJECTS 256
+#define COUNT 1024*4
+#endif
+
+static void *threadfn(void *arg __unused)
+{
+    id objs[OBJECTS];
+    id weaks[OBJECTS];
+
+    for (int i = 0; i < OBJECTS; i++) {
+        objs[i] = [TestRoot new];
+        objc_initWeak(&weaks[i], objs[i]);
+    }
+
+    for (int n = 0; n < COUNT; n++) {
+        for (int i = 0; i < OBJECTS; i++) {
+            id value = objc_loadWeakRetained(&weaks[i]);
+            testassert(value == objs[i]);
+            objc_storeWeak(&weaks[i], value);
+            [value release];
+        }
+    }
+
+    for (int i = 0; i < OBJECTS; i++) {
+        objc_destroyWeak(&weaks[i]);
+        [objs[i] release];
+    }
+
+    return NULL;
+}
+
+static double run(int threadCount)
+{
+    pthread_t threads[THREADS];
+    struct timeval start, end;
+
+    gettimeofday(&start, NULL);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_create(&threads[t], NULL, &threadfn, NULL);
+    }
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    gettimeofday(&end, NULL);
+
+    return (end.tv_sec - start.tv_sec) +
+        (end.tv_usec - start.tv_usec) / 1000000.0;
+}
+
+int main()
+{
+    // Each thread does the same work, so perfect scaling keeps the
+    // per-thread time flat.
+    double single = run(1);
+    double all = run(THREADS);
+    testprintf("1 thread: %.3fs, %d threads: %.3fs (%.2fx per thread)\n",
+               single, THREADS, all, all / single);
+
+    succeed(__FILE__);
+}
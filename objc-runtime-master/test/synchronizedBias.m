@@ -0,0 +1,79 @@
+// TEST_CONFIG
+
+#include "test.h"
+
+#include <pthread.h>
+#include <objc/objc-sync.h>
+#include <Foundation/NSObject.h>
+
+// A thread's most recent @synchronized object stays cached on that thread
+// after it unlocks. The cached object must still behave like an unlocked
+// lock: other threads can take it, and exiting it again is an error.
+// Many distinct objects exercise the per-stripe hash tables.
+
+#define OBJECTS 4096
+#define THREADS 8
+#define ROUNDS 64
+
+static id objs[OBJECTS];
+static int counters[OBJECTS];
+
+static void *other(void *arg)
+{
+    testassert(objc_sync_try_enter((id)arg));
+    testassert(objc_sync_exit((id)arg) == OBJC_SYNC_SUCCESS);
+    return NULL;
+}
+
+static void *worker(void *arg)
+{
+    int offset = (int)(intptr_t)arg;
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < OBJECTS; i++) {
+            id obj = objs[(i + offset * 97) % OBJECTS];
+            testassert(objc_sync_enter(obj) == OBJC_SYNC_SUCCESS);
+            counters[(i + offset * 97) % OBJECTS]++;
+            testassert(objc_sync_exit(obj) == OBJC_SYNC_SUCCESS);
+        }
+    }
+    return NULL;
+}
+
+int main()
+{
+    id obj = [NSObject new];
+
+    // Uncontended re-entry on one thread.
+    for (int i = 0; i < 1000; i++) {
+        testassert(objc_sync_enter(obj) == OBJC_SYNC_SUCCESS);
+        testassert(objc_sync_enter(obj) == OBJC_SYNC_SUCCESS);
+        testassert(objc_sync_exit(obj) == OBJC_SYNC_SUCCESS);
+        testassert(objc_sync_exit(obj) == OBJC_SYNC_SUCCESS);
+    }
+
+    // Cached but not held.
+    testassert(objc_sync_exit(obj) == OBJC_SYNC_NOT_OWNING_THREAD_ERROR);
+
+    pthread_t th;
+    pthread_create(&th, NULL, &other, obj);
+    pthread_join(th, NULL);
+
+    // Still usable here after another thread took it.
+    testassert(objc_sync_enter(obj) == OBJC_SYNC_SUCCESS);
+    testassert(objc_sync_exit(obj) == OBJC_SYNC_SUCCESS);
+
+    // Many objects, many threads.
+    for (int i = 0; i < OBJECTS; i++) objs[i] = [NSObject new];
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &worker, (void *)(intptr_t)t);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    for (int i = 0; i < OBJECTS; i++) {
+        testassert(counters[i] == THREADS * ROUNDS);
+    }
+
+    succeed(__FILE__);
+}
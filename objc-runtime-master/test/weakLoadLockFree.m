@@ -0,0 +1,75 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include <Foundation/NSObject.h>
+#include <pthread.h>
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+
+// objc_loadWeakRetained reads weak variables without the SideTable lock.
+// A load racing with the referent's deallocation must return either a
+// live, retained object or nil, never a freed one.
+
+#define READERS 4
+#define ROUNDS 20000
+
+static int deallocs;
+static int liveLoads;
+
+@interface WeakTarget : NSObject {
+  @public
+    int canary;
+}
+@end
+@implementation WeakTarget
+-(void)dealloc {
+    canary = 0;
+    __sync_fetch_and_add(&deallocs, 1);
+    [super dealloc];
+}
+@end
+
+static id weakVar;
+static volatile bool done;
+
+static void *reader(void *arg __unused)
+{
+    while (!done) {
+        WeakTarget *obj = objc_loadWeakRetained(&weakVar);
+        if (obj) {
+            testassert(obj->canary == 42);
+            __sync_fetch_and_add(&liveLoads, 1);
+            [obj release];
+        }
+    }
+    return NULL;
+}
+
+int main()
+{
+    objc_initWeak(&weakVar, nil);
+
+    pthread_t threads[READERS];
+    for (int t = 0; t < READERS; t++) {
+        pthread_create(&threads[t], NULL, &reader, NULL);
+    }
+
+    for (int i = 0; i < ROUNDS; i++) {
+        WeakTarget *obj = [WeakTarget new];
+        obj->canary = 42;
+        objc_storeWeak(&weakVar, obj);
+        [obj release];
+    }
+
+    done = true;
+    for (int t = 0; t < READERS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    testassert(deallocs == ROUNDS);
+    testprintf("%d live loads\n", liveLoads);
+
+    testassert(objc_loadWeakRetained(&weakVar) == nil);
+
+    objc_destroyWeak(&weakVar);
+    succeed(__FILE__);
+}
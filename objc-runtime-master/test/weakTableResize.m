@@ -0,0 +1,63 @@
+// TEST_CONFIG MEM=mrc
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+
+// Weak tables resize a few entries at a time. Every weak variable must
+// stay registered while entries are split between the old and new
+// arrays, through both growing and shrinking.
+
+#define COUNT 100000
+
+static id objs[COUNT];
+static id weaks[COUNT];
+
+int main()
+{
+    objc_weak_table_statistics stats;
+    objc_weak_getStatistics(&stats);
+    unsigned long baseline = stats.entries;
+    testassert(stats.tables > 0);
+
+    for (int i = 0; i < COUNT; i++) {
+        objs[i] = [TestRoot new];
+        objc_initWeak(&weaks[i], objs[i]);
+        // Earlier entries may be mid-move.
+        if (i % 97 == 0) {
+            int j = i / 2;
+            id loaded = objc_loadWeakRetained(&weaks[j]);
+            testassert(loaded == objs[j]);
+            [loaded release];
+        }
+    }
+
+    objc_weak_getStatistics(&stats);
+    testassert(stats.entries == baseline + COUNT);
+    testassert(stats.capacity > stats.entries);
+    testprintf("%lu entries, %lu slots, max displacement %lu, "
+               "%lu tables resizing\n", stats.entries, stats.capacity,
+               stats.maxDisplacement, stats.resizing);
+
+    for (int i = 0; i < COUNT; i++) {
+        id loaded = objc_loadWeakRetained(&weaks[i]);
+        testassert(loaded == objs[i]);
+        [loaded release];
+    }
+
+    // Deallocation clears every weak variable, even as the tables shrink.
+    TestRootDealloc = 0;
+    for (int i = 0; i < COUNT; i++) {
+        [objs[i] release];
+    }
+    testassert(TestRootDealloc == COUNT);
+    for (int i = 0; i < COUNT; i++) {
+        testassert(weaks[i] == nil);
+        objc_destroyWeak(&weaks[i]);
+    }
+
+    objc_weak_getStatistics(&stats);
+    testassert(stats.entries == baseline);
+
+    succeed(__FILE__);
+}